@@ -0,0 +1,65 @@
+#include <stdlib.h>
+#include "affinity.h"
+
+/**
+ * @brief Parse a CPU list in the taskset -c form, e.g. "0-3,6".
+ * @return FALSE if str is malformed, empty or names a CPU the system does not have
+ */
+gboolean
+gst_sscma_cpu_mask_parse (const gchar * str, ncnn::CpuSet & set)
+{
+  const int num_cpus = ncnn::get_cpu_count ();
+  const gchar *p = str;
+  gchar *end;
+  long first, last;
+
+  set.disable_all ();
+  while (*p != '\0') {
+    first = strtol (p, &end, 10);
+    if (end == p || first < 0)
+      return FALSE;
+    last = first;
+    p = end;
+    if (*p == '-') {
+      last = strtol (p + 1, &end, 10);
+      if (end == p + 1 || last < first)
+        return FALSE;
+      p = end;
+    }
+    if (last >= num_cpus)
+      return FALSE;
+    for (long cpu = first; cpu <= last; cpu++)
+      set.enable ((int) cpu);
+
+    if (*p == ',')
+      p++;
+    else if (*p != '\0')
+      return FALSE;
+  }
+
+  return set.num_enabled () > 0;
+}
+
+/**
+ * @brief Pin the calling thread to the CPUs of mask, or to the cores powersave picks if mask is empty.
+ *
+ * ncnn runs the layers of an extractor on the thread calling it, so pinning
+ * the threads calling extract pins the inference. Unlike
+ * ncnn::set_cpu_powersave, nothing process-wide is changed, so several
+ * elements can use different cores.
+ * @param powersave 0 for all cores, 1 for the little ones, 2 for the big ones
+ * @return FALSE if mask is malformed or the kernel refused the affinity
+ */
+gboolean
+gst_sscma_set_thread_affinity (const gchar * mask, gint powersave)
+{
+  ncnn::CpuSet set;
+
+  if (mask && mask[0] != '\0') {
+    if (!gst_sscma_cpu_mask_parse (mask, set))
+      return FALSE;
+  } else
+    set = ncnn::get_cpu_thread_affinity_mask (powersave);
+
+  return ncnn::set_cpu_thread_affinity (set) == 0;
+}
@@ -0,0 +1,10 @@
+#ifndef __GST_SSCMA_AFFINITY_H__
+#define __GST_SSCMA_AFFINITY_H__
+
+#include <glib.h>
+#include <cpu.h>
+
+gboolean gst_sscma_cpu_mask_parse (const gchar * str, ncnn::CpuSet & set);
+gboolean gst_sscma_set_thread_affinity (const gchar * mask, gint powersave);
+
+#endif /* __GST_SSCMA_AFFINITY_H__ */
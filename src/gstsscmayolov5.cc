@@ -66,8 +66,12 @@
 #include <json-glib/json-glib.h>
 
 #include "gstsscmayolov5.h"
+#include "gstsscmayolov5multi.h"
 #include "tensor_info.h"
-#include <net.h>
+#include "model_cache.h"
+#include "layer/input.h"
+#include "preprocess.h"
+#include "motion.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_sscma_yolov5_debug);
 #define GST_CAT_DEFAULT gst_sscma_yolov5_debug
@@ -85,8 +89,77 @@ enum
   PROP_THRESHOLD,
   PROP_NUMTHREADS,
   PROP_IS_OUTPUT_SCALED,
+  PROP_ASYNC,
+  PROP_MAX_QUEUE_SIZE,
+  PROP_DROP_POLICY,
+  PROP_DROPPED,
+  PROP_INFLIGHT,
+  PROP_ALLOCATIONS,
+  PROP_INT8_MODEL,
+  PROP_INT8_TABLE,
+  PROP_USE_FP16_STORAGE,
+  PROP_USE_FP16_ARITHMETIC,
+  PROP_USE_BF16_STORAGE,
+  PROP_USE_PACKING_LAYOUT,
+  PROP_USE_WINOGRAD_CONVOLUTION,
+  PROP_USE_SGEMM_CONVOLUTION,
+  PROP_LIGHTMODE,
+  PROP_MMAP,
+  PROP_WARMUP_RUNS,
+  PROP_LOAD_TIME,
+  PROP_WARMUP_TIME,
+  PROP_LETTERBOX,
+  PROP_INTERVAL,
+  PROP_MAX_RATE,
+  PROP_ADAPTIVE_INTERVAL,
+  PROP_REUSED,
+  PROP_MOTION_THRESHOLD,
+  PROP_MOTION_PIXEL_THRESHOLD,
+  PROP_MOTION_SKIPPED,
+  PROP_TILE_SIZE,
+  PROP_TILE_OVERLAP,
+  PROP_MAX_TILES,
+  PROP_TILE_GLOBAL,
+  PROP_ROI,
+  PROP_POWERSAVE,
+  PROP_CPU_MASK,
+  PROP_STREAMING_CPU_MASK,
+  PROP_DECODER,
+  PROP_INPUT_BLOB,
+  PROP_OUTPUT_BLOBS,
+  PROP_ANCHORS,
+  PROP_MAX_SCORE,
 };
 
+#define DEFAULT_ASYNC FALSE
+#define DEFAULT_MAX_QUEUE_SIZE 2
+#define DEFAULT_DROP_POLICY GST_SSCMA_YOLOV5_DROP_OLDEST
+#define DEFAULT_INFLIGHT 1
+#define DEFAULT_MMAP FALSE
+#define DEFAULT_WARMUP_RUNS 1
+#define DEFAULT_LETTERBOX FALSE
+#define DEFAULT_INTERVAL 1
+#define DEFAULT_MAX_RATE 0.0
+#define DEFAULT_ADAPTIVE_INTERVAL FALSE
+#define DEFAULT_MOTION_THRESHOLD 0.0
+#define DEFAULT_MOTION_PIXEL_THRESHOLD 15
+#define DEFAULT_TILE_SIZE 0
+#define DEFAULT_TILE_OVERLAP 0.2
+#define DEFAULT_MAX_TILES 16
+#define DEFAULT_TILE_GLOBAL TRUE
+#define DEFAULT_POWERSAVE GST_SSCMA_YOLOV5_POWERSAVE_ALL
+#define DEFAULT_DECODER GST_SSCMA_DECODER_YOLOV5
+#define DEFAULT_INPUT_BLOB "in0"
+#define DEFAULT_OUTPUT_BLOBS "out0"
+/* yolov5 P3, P4 and P5 anchors */
+#define DEFAULT_ANCHORS "10,13,16,30,33,23;30,61,62,45,59,119;116,90,156,198,373,326"
+/* percent scores, the 2500 default threshold is for; also holds for probabilities */
+#define DEFAULT_MAX_SCORE 100.f
+
+/* adaptive interval: fraction of boxes that changed since the last inference */
+#define ADAPTIVE_CHANGE_HIGH 0.3f /**< above this, halve the interval */
+#define ADAPTIVE_CHANGE_LOW 0.1f /**< below this, grow the interval by one frame */
+
 /* the capabilities of the outputs.
  *
  * describe the real formats here.
@@ -98,23 +171,92 @@ G_DEFINE_TYPE (GstSscmaYolov5, gst_sscma_yolov5, GST_TYPE_ELEMENT);
 GST_ELEMENT_REGISTER_DEFINE (sscma_yolov5, "sscma_yolov5", GST_RANK_NONE,
     GST_TYPE_SSCMAYOLOV5);
 
-ncnn::Net net;
+GType
+gst_sscma_yolov5_drop_policy_get_type (void)
+{
+  static GType drop_policy_type = 0;
+  static const GEnumValue drop_policy[] = {
+    {GST_SSCMA_YOLOV5_DROP_BLOCK, "Block until the worker takes a frame",
+        "block"},
+    {GST_SSCMA_YOLOV5_DROP_NEWEST, "Drop the incoming frame", "drop-newest"},
+    {GST_SSCMA_YOLOV5_DROP_OLDEST, "Drop the oldest queued frame",
+        "drop-oldest"},
+    {0, NULL, NULL},
+  };
+
+  if (!drop_policy_type) {
+    drop_policy_type =
+        g_enum_register_static ("GstSscmaYolov5DropPolicy", drop_policy);
+  }
+  return drop_policy_type;
+}
+
+GType
+gst_sscma_decoder_get_type (void)
+{
+  static GType decoder_type = 0;
+  static const GEnumValue decoder[] = {
+    {GST_SSCMA_DECODER_YOLOV5, "YOLOv5 [anchors, 5 + classes] with objectness",
+        "yolov5"},
+    {GST_SSCMA_DECODER_YOLOV8,
+        "YOLOv8 / YOLOv11 anchor-free [4 + classes, anchors]", "yolov8"},
+    {GST_SSCMA_DECODER_YOLOV5_RAW,
+        "Raw YOLOv5 heads, one blob per stride, grid and anchor decode",
+        "yolov5-raw"},
+    {0, NULL, NULL},
+  };
+
+  if (!decoder_type) {
+    decoder_type = g_enum_register_static ("GstSscmaDecoder", decoder);
+  }
+  return decoder_type;
+}
+
+GType
+gst_sscma_yolov5_powersave_get_type (void)
+{
+  static GType powersave_type = 0;
+  static const GEnumValue powersave[] = {
+    {GST_SSCMA_YOLOV5_POWERSAVE_ALL, "Any core", "all"},
+    {GST_SSCMA_YOLOV5_POWERSAVE_LITTLE, "Little cores only", "little"},
+    {GST_SSCMA_YOLOV5_POWERSAVE_BIG, "Big cores only", "big"},
+    {0, NULL, NULL},
+  };
+
+  if (!powersave_type) {
+    powersave_type =
+        g_enum_register_static ("GstSscmaYolov5Powersave", powersave);
+  }
+  return powersave_type;
+}
 
 static void gst_properties_init(GstSscmaYolov5Properties *prop);
+static gboolean _gtfc_parse_anchors (GstSscmaYolov5Properties * prop,
+    const gchar * str);
 static void gst_sscma_yolov5_set_property (GObject * object,
     guint prop_id, const GValue * value, GParamSpec * pspec);
 static void gst_sscma_yolov5_get_property (GObject * object,
     guint prop_id, GValue * value, GParamSpec * pspec);
 static void gst_sscma_yolov5_finalize (GObject * object);
+static GstStateChangeReturn gst_sscma_yolov5_change_state (GstElement *
+    element, GstStateChange transition);
 
 static gboolean gst_sscma_yolov5_sink_event (GstPad * pad,
     GstObject * parent, GstEvent * event);
 static gboolean gst_sscma_yolov5_sink_query (GstPad * pad,
     GstObject * parent, GstQuery * query);
+static gboolean gst_sscma_yolov5_src_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
 static gboolean gst_sscma_yolov5_src_query (GstPad * pad,
     GstObject * parent, GstQuery * query);
 static GstFlowReturn gst_sscma_yolov5_chain (GstPad * pad,
     GstObject * parent, GstBuffer * buf);
+static GstFlowReturn gst_sscma_yolov5_process (GstSscmaYolov5 * self,
+    GstSscmaYolov5Context * ctx, GstBuffer * buf, gboolean infer,
+    GstBuffer ** outbuf);
+static gpointer gst_sscma_yolov5_worker (gpointer data);
+static gboolean gst_sscma_yolov5_roi_event (GstSscmaYolov5 * self,
+    GstEvent * event, gboolean locked);
 
 static GstCaps * gst_sscma_yolov5_query_caps (GstSscmaYolov5 * self, GstPad * pad,
     GstCaps * filter);
@@ -122,9 +264,6 @@ static gboolean gst_sscma_yolov5_parse_caps (GstSscmaYolov5 * self,
     const GstCaps * caps);
 static gboolean gst_sscma_yolov5_update_caps (GstSscmaYolov5 * self, GstCaps * in_caps);
 
-static void nms (GArray * results, gfloat threshold);
-static void draw (GstMapInfo * out_info, GstSscmaYolov5 *self, GArray * results);
-static guint convert_json (char ** outbuf, GstMapInfo imgdata, GArray * results, GArray * infer_time);
 /* initialize the sscmayolov5's class */
 static void
 gst_sscma_yolov5_class_init (GstSscmaYolov5Class * klass)
@@ -133,6 +272,7 @@ gst_sscma_yolov5_class_init (GstSscmaYolov5Class * klass)
   GstElementClass *gstelement_class;
   GstPadTemplate *pad_template;
   GstCaps *pad_caps;
+  ncnn::Option opt;
 
   gobject_class = (GObjectClass *) klass;
   gstelement_class = (GstElementClass *) klass;
@@ -140,46 +280,320 @@ gst_sscma_yolov5_class_init (GstSscmaYolov5Class * klass)
   gobject_class->set_property = gst_sscma_yolov5_set_property;
   gobject_class->get_property = gst_sscma_yolov5_get_property;
   gobject_class->finalize = gst_sscma_yolov5_finalize;
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_sscma_yolov5_change_state);
 
   g_object_class_install_property (gobject_class, PROP_MODEL,
       g_param_spec_string ("model", "Model filepath",
           "File path to the model file. Separated with ',' in case of multiple model files",
-          "", G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
+          "", (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_INT8_MODEL,
+      g_param_spec_string ("int8-model", "INT8 model filepath",
+          "File paths to an int8 quantized bin,param pair, loaded instead of model when set",
+          "", (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_INT8_TABLE,
+      g_param_spec_string ("int8-table", "INT8 calibration table",
+          "Calibration table the int8 model was quantized with (see sscma-calibrate), "
+          "checked against the loaded network",
+          "", (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MMAP,
+      g_param_spec_boolean ("mmap", "Memory-map the model",
+          "Map the model files and use the weights in place from the page cache, "
+          "so processes running the same model share them. Accepts a text "
+          ".param or an ncnn2mem .param.bin",
+          DEFAULT_MMAP,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_WARMUP_RUNS,
+      g_param_spec_uint ("warmup-runs", "Warm-up runs",
+          "Inferences run on a synthetic frame when going to PAUSED, so the "
+          "first real frame does not pay ncnn's first-run cost",
+          0, 100, DEFAULT_WARMUP_RUNS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_LOAD_TIME,
+      g_param_spec_double ("load-time", "Load time",
+          "Milliseconds spent loading the model on the last READY to PAUSED "
+          "transition, close to 0 when the model was already cached",
+          0, G_MAXDOUBLE, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_WARMUP_TIME,
+      g_param_spec_double ("warmup-time", "Warm-up time",
+          "Milliseconds spent in warm-up inferences on the last READY to "
+          "PAUSED transition",
+          0, G_MAXDOUBLE, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
 
   g_object_class_install_property (gobject_class, PROP_INPUT,
       g_param_spec_string ("input", "Input dimension",
-          "Input tensor dimension from inner array (Max rank #NNS_TENSOR_RANK_LIMIT)",
-          "3:320:320", G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
+          "Input tensor dimension from inner array (Max rank #NNS_TENSOR_RANK_LIMIT), "
+          "derived from the model if not set",
+          "3:320:320", (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   g_object_class_install_property (gobject_class, PROP_OUTPUT,
       g_param_spec_string ("output", "Output dimension",
-          "Output tensor dimension from inner array (Max rank #NNS_TENSOR_RANK_LIMIT)",
-          "85:6300:1:1", G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
+          "Output tensor dimension from inner array (Max rank #NNS_TENSOR_RANK_LIMIT), "
+          "derived from the model if not set",
+          "85:6300:1:1", (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   g_object_class_install_property (gobject_class, PROP_OUTPUTTYPE,
       g_param_spec_string ("outputtype", "Output tensor element type",
           "Type of each element of the output tensor ?", "float32",
-          G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_LETTERBOX,
+      g_param_spec_boolean ("letterbox", "Letterbox",
+          "Keep the frame's aspect ratio: scale its longest side to the input "
+          "size and pad the other one to the next multiple of 32, e.g. a 16:9 "
+          "frame runs at 320x192. Needs a model exported with dynamic shapes",
+          DEFAULT_LETTERBOX,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_DECODER,
+      g_param_spec_enum ("decoder", "Output head decoder",
+          "How the output blobs hold the boxes. yolov8 also decodes yolov11, "
+          "yolov5-raw needs one output blob per stride and the anchors",
+          GST_TYPE_SSCMA_DECODER, DEFAULT_DECODER,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_INPUT_BLOB,
+      g_param_spec_string ("input-blob", "Input blob",
+          "Name of the input blob, unused by .param.bin models",
+          DEFAULT_INPUT_BLOB,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_OUTPUT_BLOBS,
+      g_param_spec_string ("output-blobs", "Output blobs",
+          "Comma separated names of the output blobs, .param.bin models use "
+          "as many outputs as names, in declaration order",
+          DEFAULT_OUTPUT_BLOBS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_ANCHORS,
+      g_param_spec_string ("anchors", "Anchors",
+          "Anchors of the yolov5-raw decoder in input pixels: 3 w,h pairs per "
+          "head, heads separated by ; from the smallest stride",
+          DEFAULT_ANCHORS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_SCORE,
+      g_param_spec_float ("max-score", "Max class score",
+          "Largest class score the yolov5 head outputs, 100 for percents, 1 "
+          "for probabilities. Anchors whose objectness times it does not pass "
+          "the threshold are skipped without a class scan. 0 if unknown",
+          0, G_MAXFLOAT, DEFAULT_MAX_SCORE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   g_object_class_install_property (gobject_class, PROP_MODE_LABELS,
       g_param_spec_string ("labels", "Labels file",
           "Configure the Labels file path.", "",
-          G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   g_object_class_install_property (gobject_class, PROP_THRESHOLD,
       g_param_spec_string ("threshold", "Threshold",
           "Configure the threshold for detection.", "2500:0.25",
-          G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   g_object_class_install_property (gobject_class, PROP_NUMTHREADS,
       g_param_spec_int ("numthreads", "Number of threads",
           "Number of threads for NNFW", 1, 4, 4,
-          G_PARAM_WRITABLE));
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   g_object_class_install_property (gobject_class, PROP_IS_OUTPUT_SCALED,
       g_param_spec_boolean ("is_output_scaled", "Is output scaled",
           "Is output scaled", TRUE,
-          G_PARAM_WRITABLE));
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_ASYNC,
+      g_param_spec_boolean ("async", "Async inference",
+          "Run inference on a worker thread so the chain function returns at once. "
+          "Takes effect on the next READY to PAUSED transition",
+          DEFAULT_ASYNC,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_QUEUE_SIZE,
+      g_param_spec_uint ("max-queue-size", "Max queue size",
+          "Max number of frames waiting for the inference worker in async mode",
+          1, 64, DEFAULT_MAX_QUEUE_SIZE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_DROP_POLICY,
+      g_param_spec_enum ("drop-policy", "Drop policy",
+          "What to do with frames when the async queue is full",
+          GST_TYPE_SSCMAYOLOV5_DROP_POLICY, DEFAULT_DROP_POLICY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_DROPPED,
+      g_param_spec_uint64 ("dropped", "Dropped frames",
+          "Number of frames dropped because the async queue was full",
+          0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_INFLIGHT,
+      g_param_spec_uint ("inflight", "Frames in flight",
+          "Number of frames inferred at once in async mode, each on its own "
+          "extractor with numthreads/inflight threads. Results are reordered "
+          "before they are pushed. Takes effect on the next READY to PAUSED transition",
+          1, 8, DEFAULT_INFLIGHT,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_INTERVAL,
+      g_param_spec_uint ("interval", "Inference interval",
+          "Infer every Nth frame, the frames in between reuse the last "
+          "detections. With adaptive-interval, the longest interval allowed",
+          1, G_MAXUINT, DEFAULT_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_RATE,
+      g_param_spec_double ("max-rate", "Max inference rate",
+          "Max inferences per second of stream time, the frames in between "
+          "reuse the last detections. 0 for no limit",
+          0, G_MAXDOUBLE, DEFAULT_MAX_RATE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_ADAPTIVE_INTERVAL,
+      g_param_spec_boolean ("adaptive-interval", "Adaptive interval",
+          "Shorten the interval when the detections change a lot between "
+          "inferences, lengthen it up to interval while the scene is stable",
+          DEFAULT_ADAPTIVE_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_REUSED,
+      g_param_spec_uint64 ("reused", "Reused frames",
+          "Number of frames that reused the last detections instead of being inferred",
+          0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MOTION_THRESHOLD,
+      g_param_spec_double ("motion-threshold", "Motion threshold",
+          "Fraction of the 80x45 luma thumbnail that must differ from the last "
+          "inferred frame for a frame to be inferred, the others reuse the last "
+          "detections. 0 to infer regardless of motion",
+          0, 1, DEFAULT_MOTION_THRESHOLD,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MOTION_PIXEL_THRESHOLD,
+      g_param_spec_uint ("motion-pixel-threshold", "Motion pixel threshold",
+          "Luma difference above which a thumbnail pixel counts as changed",
+          0, 254, DEFAULT_MOTION_PIXEL_THRESHOLD,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MOTION_SKIPPED,
+      g_param_spec_uint64 ("motion-skipped", "Motion skipped frames",
+          "Number of frames that reused the last detections for lack of motion",
+          0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_TILE_SIZE,
+      g_param_spec_uint ("tile-size", "Tile size",
+          "Cut frames into overlapping tiles of this many pixels a side, each "
+          "inferred on its own, so that small objects keep their pixels. The "
+          "model input size gives native resolution tiles. 0 to infer whole "
+          "frames. Turning tiling on takes effect on the next READY to PAUSED transition",
+          0, 8192, DEFAULT_TILE_SIZE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_TILE_OVERLAP,
+      g_param_spec_double ("tile-overlap", "Tile overlap",
+          "Min overlap of neighbour tiles, as a fraction of a tile",
+          0, 0.9, DEFAULT_TILE_OVERLAP,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_TILES,
+      g_param_spec_uint ("max-tiles", "Max tiles",
+          "Max number of tiles per frame, larger tiles are used to stay below it",
+          1, GST_SSCMA_MAX_TILES, DEFAULT_MAX_TILES,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_TILE_GLOBAL,
+      g_param_spec_boolean ("tile-global", "Global view",
+          "Also infer the whole downscaled frame, for objects larger than a tile",
+          DEFAULT_TILE_GLOBAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_ROI,
+      g_param_spec_string ("roi", "Regions of interest",
+          "Only infer these frame regions, as x:y:w:h;x:y:w:h or a JSON array "
+          "of {\"x\",\"y\",\"width\",\"height\"} objects. Empty for the whole frame. "
+          "Can also be set with a custom sscma-roi event carrying a roi string",
+          "", (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_POWERSAVE,
+      g_param_spec_enum ("powersave", "Powersave",
+          "Cores the inference threads run on when cpu-mask is not set, "
+          "little or big on big.LITTLE SoCs",
+          GST_TYPE_SSCMAYOLOV5_POWERSAVE, DEFAULT_POWERSAVE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_CPU_MASK,
+      g_param_spec_string ("cpu-mask", "CPU mask",
+          "CPUs the inference threads run on, as a list like 4-7 or 2,3. "
+          "Overrides powersave. In sync mode this is the streaming thread",
+          NULL, (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_STREAMING_CPU_MASK,
+      g_param_spec_string ("streaming-cpu-mask", "Streaming thread CPU mask",
+          "CPUs the streaming thread feeding the element runs on, as a list "
+          "like 0,1. Overrides cpu-mask for the streaming thread in sync mode",
+          NULL, (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_ALLOCATIONS,
+      g_param_spec_uint ("allocations", "Allocations per frame",
+          "Heap allocations ncnn made for the last inferred frame, 0 once the "
+          "allocator pools are warm",
+          0, G_MAXUINT, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  /* ncnn net options, applied when the model is loaded. Reading them back
+   * gives the values of the loaded net, which ncnn may have turned off for
+   * features the CPU lacks. */
+  g_object_class_install_property (gobject_class, PROP_USE_FP16_STORAGE,
+      g_param_spec_boolean ("use-fp16-storage", "Use fp16 storage",
+          "Store weights and blobs as fp16 where the CPU supports it",
+          opt.use_fp16_storage,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_USE_FP16_ARITHMETIC,
+      g_param_spec_boolean ("use-fp16-arithmetic", "Use fp16 arithmetic",
+          "Compute in fp16 where the CPU supports it",
+          opt.use_fp16_arithmetic,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_USE_BF16_STORAGE,
+      g_param_spec_boolean ("use-bf16-storage", "Use bf16 storage",
+          "Store weights and blobs as bf16, for CPUs without fp16 support",
+          opt.use_bf16_storage,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_USE_PACKING_LAYOUT,
+      g_param_spec_boolean ("use-packing-layout", "Use packing layout",
+          "Pack channels by 4 or 8 to fit the SIMD registers",
+          opt.use_packing_layout,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class,
+      PROP_USE_WINOGRAD_CONVOLUTION,
+      g_param_spec_boolean ("use-winograd-convolution",
+          "Use winograd convolution",
+          "Use winograd for 3x3 stride 1 convolutions, faster but more memory",
+          opt.use_winograd_convolution,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_USE_SGEMM_CONVOLUTION,
+      g_param_spec_boolean ("use-sgemm-convolution", "Use sgemm convolution",
+          "Use im2col + sgemm for convolutions, faster but more memory",
+          opt.use_sgemm_convolution,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_LIGHTMODE,
+      g_param_spec_boolean ("lightmode", "Light mode",
+          "Recycle intermediate blobs as soon as they are consumed",
+          opt.lightmode,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   /* set src pad template */
   pad_caps = gst_caps_new_empty ();
@@ -233,11 +647,49 @@ gst_sscma_yolov5_init (GstSscmaYolov5 * self)
       (GST_ELEMENT_GET_CLASS (self), "src"), "src");
   gst_pad_set_query_function (self->srcpad,
       GST_DEBUG_FUNCPTR (gst_sscma_yolov5_src_query));
+  gst_pad_set_event_function (self->srcpad,
+      GST_DEBUG_FUNCPTR (gst_sscma_yolov5_src_event));
   GST_PAD_SET_PROXY_CAPS (self->srcpad);
   gst_element_add_pad (GST_ELEMENT (self), self->srcpad);
 
   /* init null */
   memset (prop, 0, sizeof (GstSscmaYolov5Properties));
+  self->model = NULL;
+  self->labels = NULL;
+  self->started = FALSE;
+  self->reloading = FALSE;
+  self->reload_thread = NULL;
+  self->config_generation = 0;
+  self->head_generation = 1;
+  self->warmup_runs = DEFAULT_WARMUP_RUNS;
+  self->load_time = 0;
+  self->warmup_time = 0;
+
+  self->async = DEFAULT_ASYNC;
+  self->max_queue_size = DEFAULT_MAX_QUEUE_SIZE;
+  self->drop_policy = DEFAULT_DROP_POLICY;
+  self->inflight = DEFAULT_INFLIGHT;
+  g_queue_init (&self->queue);
+  g_mutex_init (&self->queue_lock);
+  g_cond_init (&self->queue_cond);
+  self->contexts = NULL;
+  self->num_contexts = 0;
+  self->last_flow = GST_FLOW_OK;
+  self->interval = DEFAULT_INTERVAL;
+  self->max_rate = DEFAULT_MAX_RATE;
+  self->adaptive_interval = DEFAULT_ADAPTIVE_INTERVAL;
+  self->motion_threshold = DEFAULT_MOTION_THRESHOLD;
+  self->motion_pixel_threshold = DEFAULT_MOTION_PIXEL_THRESHOLD;
+  self->tile_size = DEFAULT_TILE_SIZE;
+  self->tile_overlap = DEFAULT_TILE_OVERLAP;
+  self->max_tiles = DEFAULT_MAX_TILES;
+  self->tile_global = DEFAULT_TILE_GLOBAL;
+  self->rois = g_array_new (FALSE, TRUE, sizeof (GstSscmaTile));
+  self->last_results = g_array_new (FALSE, TRUE, sizeof (detectedObject));
+  self->powersave = DEFAULT_POWERSAVE;
+  self->cpu_mask = NULL;
+  self->streaming_cpu_mask = NULL;
+  self->affinity_generation = 0;
 
   gst_tensors_info_init (&prop->input_meta);
   gst_tensors_layout_init (prop->input_layout);
@@ -254,10 +706,19 @@ gst_properties_init(GstSscmaYolov5Properties *prop)
   prop->model_files = NULL;
   prop->num_models = 0;
   prop->num_threads = 4;
+  prop->use_mmap = DEFAULT_MMAP;
+  prop->letterbox = DEFAULT_LETTERBOX;
+  prop->opt = ncnn::Option ();
   prop->is_output_scaled = TRUE;
+  prop->labels_file = NULL;
   prop->labels = NULL;
   prop->total_labels = 0;
   prop->max_word_length = 0;
+  prop->decoder = DEFAULT_DECODER;
+  prop->max_score = DEFAULT_MAX_SCORE;
+  prop->input_blob = g_strdup (DEFAULT_INPUT_BLOB);
+  prop->output_blobs = g_strsplit (DEFAULT_OUTPUT_BLOBS, ",", -1);
+  _gtfc_parse_anchors (prop, DEFAULT_ANCHORS);
   prop->threshold[0] = 2500;
   prop->threshold[1] = 0.25;
   prop->threshold[2] = 0;
@@ -285,8 +746,24 @@ gst_sscma_yolov5_finalize (GObject * object)
   // gst_tensor_filter_common_close_fw (prop);
   gst_tensors_info_free (&prop->input_meta);
   gst_tensors_info_free (&prop->output_meta);
-  // 释放 self->net 内存
-  self->net.clear();
+  g_strfreev ((gchar **) prop->model_files);
+  g_strfreev ((gchar **) prop->int8_model_files);
+  g_free (prop->int8_table);
+  g_free (prop->labels_file);
+  g_free (prop->input_blob);
+  g_strfreev (prop->output_blobs);
+  if (self->model)
+    gst_sscma_model_unref (self->model);
+  self->model = NULL;
+  if (self->labels)
+    gst_sscma_labels_unref (self->labels);
+  self->labels = NULL;
+  g_array_free (self->last_results, TRUE);
+  g_array_free (self->rois, TRUE);
+  g_free (self->cpu_mask);
+  g_free (self->streaming_cpu_mask);
+  g_mutex_clear (&self->queue_lock);
+  g_cond_clear (&self->queue_cond);
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -317,6 +794,453 @@ _gtfc_setprop_MODEL (GstSscmaYolov5 * priv,
   return 0;
 }
 
+/** @brief Handle "PROP_INT8_MODEL" for set-property */
+static gint
+_gtfc_setprop_INT8_MODEL (GstSscmaYolov5Properties * prop, const GValue * value)
+{
+  const gchar *model_files = g_value_get_string (value);
+
+  g_strfreev ((gchar **) prop->int8_model_files);
+  prop->int8_model_files = NULL;
+  prop->num_int8_models = 0;
+
+  if (model_files && model_files[0] != '\0') {
+    prop->int8_model_files = (const gchar **) g_strsplit_set (model_files, ",", -1);
+    prop->num_int8_models = g_strv_length ((gchar **) prop->int8_model_files);
+  }
+  return 0;
+}
+
+/**
+ * @brief Load the configured network, the int8 pair wins over the float one.
+ * @param[out] load_time ms spent loading it
+ * @param[out] path param file of the network, may be NULL
+ * @param[out] error why no network was loaded
+ * @return a model reference, NULL if no model is configured or it cannot be loaded
+ */
+static GstSscmaModel *
+gst_sscma_yolov5_open_model (GstSscmaYolov5 * self, gdouble * load_time,
+    gchar ** path, gchar ** error)
+{
+  GstSscmaYolov5Properties *prop = &self->prop;
+  gchar **files = NULL, *int8_table = NULL;
+  GstSscmaModel *model;
+  ncnn::Option opt;
+  gboolean use_mmap;
+  gint64 start;
+
+  /* the files may change under us while playing, work on a copy */
+  GST_OBJECT_LOCK (self);
+  if (prop->num_int8_models > 1) {
+    files = g_strdupv ((gchar **) prop->int8_model_files);
+    int8_table = g_strdup (prop->int8_table);
+  } else if (prop->num_models > 1)
+    files = g_strdupv ((gchar **) prop->model_files);
+  opt = prop->opt;
+  use_mmap = prop->use_mmap;
+  GST_OBJECT_UNLOCK (self);
+
+  if (files == NULL) {
+    *error = g_strdup ("No model configured, please set the model property.");
+    return NULL;
+  }
+
+  start = g_get_monotonic_time ();
+  // instances using the same files and options share one copy
+  model = gst_sscma_model_cache_acquire (files[1], files[0], opt, use_mmap);
+  if (model == NULL)
+    *error = g_strdup_printf ("Failed to load model %s", files[1]);
+  else if (int8_table && int8_table[0] != '\0'
+      && !gst_sscma_model_check_int8_table (model, int8_table)) {
+    GST_ELEMENT_WARNING (self, RESOURCE, SETTINGS,
+        ("Calibration table %s does not match model %s", int8_table,
+            files[1]), (NULL));
+  }
+  *load_time = (g_get_monotonic_time () - start) / 1000.0;
+
+  if (path)
+    *path = g_strdup (files[1]);
+  g_strfreev (files);
+  g_free (int8_table);
+
+  return model;
+}
+
+/**
+ * @brief Load the configured labels file.
+ * @param[out] labels the labels, NULL if no labels file is set
+ * @param[out] error why the labels file cannot be read
+ * @return FALSE if the labels file cannot be read
+ */
+static gboolean
+gst_sscma_yolov5_open_labels (GstSscmaYolov5 * self, GstSscmaLabels ** labels,
+    gchar ** error)
+{
+  GError *err = NULL;
+  gchar *path;
+
+  GST_OBJECT_LOCK (self);
+  path = g_strdup (self->prop.labels_file);
+  GST_OBJECT_UNLOCK (self);
+
+  *labels = NULL;
+  if (path == NULL)
+    return TRUE;
+
+  *labels = gst_sscma_labels_new_from_file (path, &err);
+  g_free (path);
+  if (*labels == NULL) {
+    *error = g_strdup (err->message);
+    g_clear_error (&err);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**
+ * @brief Feed in to the model and extract its output blobs.
+ * @return 0 on success, non-zero if a blob is missing or a layer fails
+ */
+static int
+gst_sscma_yolov5_extract (GstSscmaModel * model, ncnn::Extractor * ex,
+    const gchar * input_blob, gchar ** output_blobs, guint num_outs,
+    const ncnn::Mat & in, ncnn::Mat * outs)
+{
+  int ret;
+  guint i;
+
+  if (model->input_index >= 0) {
+    /* .param.bin models carry no blob names, outputs go in declaration order */
+    const std::vector<int> & outputs = model->net.output_indexes ();
+
+    ret = ex->input (model->input_index, in);
+    for (i = 0; ret == 0 && i < num_outs; i++)
+      ret = i < outputs.size () ? ex->extract (outputs[i], outs[i]) : -1;
+  } else {
+    ret = ex->input (input_blob, in);
+    for (i = 0; ret == 0 && i < num_outs; i++)
+      ret = ex->extract (output_blobs[i], outs[i]);
+  }
+
+  return ret;
+}
+
+/**
+ * @brief Find the input and output shapes of a model with one dry run.
+ *
+ * The input size comes from the model's Input layer when it declares one,
+ * else from the input property. The outputs must fit the decoder, and the
+ * input and output properties, if set, must match the model.
+ * @param update TRUE to store the shapes in the input and output properties,
+ *        FALSE to only accept a model with the shapes already stored there
+ * @param[out] error why the model does not fit
+ * @return FALSE if the model cannot run or does not match
+ */
+static gboolean
+gst_sscma_yolov5_probe_model (GstSscmaYolov5 * self, GstSscmaModel * model,
+    gboolean update, gchar ** error)
+{
+  GstSscmaYolov5Properties *prop = &self->prop;
+  GstTensorInfo *input = &prop->input_meta.info[0];
+  GstTensorInfo *output = &prop->output_meta.info[0];
+  const std::vector<ncnn::Layer *> & layers = model->net.layers ();
+  ncnn::Mat in, outs[GST_SSCMA_MAX_OUTPUTS];
+  gchar *input_blob, **output_blobs;
+  GstSscmaDecoder decoder;
+  gboolean check_input, check_output, letterbox;
+  int width, height;
+  guint num_outs, i;
+
+  GST_OBJECT_LOCK (self);
+  decoder = prop->decoder;
+  input_blob = g_strdup (prop->input_blob);
+  output_blobs = g_strdupv (prop->output_blobs);
+  letterbox = prop->letterbox;
+  GST_OBJECT_UNLOCK (self);
+  num_outs = MIN (g_strv_length (output_blobs), GST_SSCMA_MAX_OUTPUTS);
+
+  /* once running, a swapped model must keep the shapes caps were set up with */
+  check_input = !update || prop->input_configured;
+  check_output = !update || prop->output_configured;
+  width = input->dimension[1];
+  height = input->dimension[2];
+
+  for (i = 0; i < layers.size (); i++) {
+    const ncnn::Input *layer = (const ncnn::Input *) layers[i];
+
+    if (layers[i]->type != "Input")
+      continue;
+    /* 0 for models exported with a dynamic input size */
+    if (layer->w > 0 && layer->h > 0) {
+      if (check_input && (layer->w != width || layer->h != height)) {
+        *error = g_strdup_printf ("Model input is %dx%d, but the input "
+            "property is %dx%d", layer->w, layer->h, width, height);
+        goto fail;
+      }
+      width = layer->w;
+      height = layer->h;
+    }
+    break;
+  }
+
+  {
+    ncnn::Extractor ex = model->net.create_extractor ();
+
+    in.create (width, height, 3);
+    in.fill (0.5f);
+    if (gst_sscma_yolov5_extract (model, &ex, input_blob, output_blobs,
+            num_outs, in, outs) != 0 || outs[0].empty ()) {
+      *error = g_strdup_printf ("Cannot run the model on a %dx%d input, check "
+          "the input-blob and output-blobs properties", width, height);
+      goto fail;
+    }
+  }
+
+  if (gst_sscma_decoder_select (decoder, outs, num_outs) == NULL) {
+    *error = g_strdup_printf ("Model output %dx%dx%d does not fit the %s "
+        "decoder", outs[0].w, outs[0].h, outs[0].c,
+        g_enum_get_value (G_ENUM_CLASS (g_type_class_peek
+                (GST_TYPE_SSCMA_DECODER)), decoder)->value_nick);
+    goto fail;
+  }
+
+  /* the number of anchors follows the input shape when letterboxing */
+  if (check_output && (outs[0].w != (int) output->dimension[0]
+          || (!letterbox && outs[0].h != (int) output->dimension[1]))) {
+    *error = g_strdup_printf ("Model output is %d:%d, but the output "
+        "property is %u:%u", outs[0].w, outs[0].h, output->dimension[0],
+        output->dimension[1]);
+    goto fail;
+  }
+
+  if (update) {
+    input->dimension[1] = width;
+    input->dimension[2] = height;
+    prop->output_meta.num_tensors = num_outs;
+    for (i = 0; i < num_outs; i++) {
+      GstTensorInfo *info = &prop->output_meta.info[i];
+
+      info->type = _TENOR_FLOAT32;
+      info->dimension[0] = outs[i].w;
+      info->dimension[1] = outs[i].h;
+      info->dimension[2] = outs[i].c;
+      info->dimension[3] = 1;
+      prop->output_ranks[i] = 4;
+    }
+    GST_INFO_OBJECT (self, "Model input %dx%d, output %d:%d:%d in %u blob(s)",
+        width, height, outs[0].w, outs[0].h, outs[0].c, num_outs);
+  }
+
+  g_free (input_blob);
+  g_strfreev (output_blobs);
+  return TRUE;
+
+fail:
+  g_free (input_blob);
+  g_strfreev (output_blobs);
+  return FALSE;
+}
+
+static void gst_sscma_yolov5_reload (GstSscmaYolov5 * self);
+
+/**
+ * @brief Load the model and labels when starting, from then on changing them hot-swaps them.
+ * @return FALSE if no model is configured or it cannot be loaded
+ */
+static gboolean
+gst_sscma_yolov5_load_model (GstSscmaYolov5 * self)
+{
+  GstSscmaModel *model, *old_model;
+  GstSscmaLabels *labels, *old_labels;
+  gdouble load_time;
+  gchar *error = NULL;
+  guint generation;
+  gboolean changed;
+
+  GST_OBJECT_LOCK (self);
+  generation = self->config_generation;
+  GST_OBJECT_UNLOCK (self);
+
+  model = gst_sscma_yolov5_open_model (self, &load_time, NULL, &error);
+  if (model == NULL) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND, ("%s", error), (NULL));
+    g_free (error);
+    return FALSE;
+  }
+  /* fail now rather than on the first frame */
+  if (!gst_sscma_yolov5_probe_model (self, model, TRUE, &error)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, SETTINGS, ("%s", error), (NULL));
+    g_free (error);
+    gst_sscma_model_unref (model);
+    return FALSE;
+  }
+  if (!gst_sscma_yolov5_open_labels (self, &labels, &error)) {
+    GST_ELEMENT_WARNING (self, RESOURCE, NOT_FOUND, ("%s", error), (NULL));
+    g_free (error);
+  }
+
+  GST_OBJECT_LOCK (self);
+  old_model = self->model;
+  old_labels = self->labels;
+  self->model = model;
+  self->labels = labels;
+  self->load_time = load_time;
+  self->started = TRUE;
+  changed = generation != self->config_generation;
+  GST_OBJECT_UNLOCK (self);
+
+  if (old_model)
+    gst_sscma_model_unref (old_model);
+  if (old_labels)
+    gst_sscma_labels_unref (old_labels);
+
+  /* the files changed while loading, pick the new ones up in the background */
+  if (changed)
+    gst_sscma_yolov5_reload (self);
+
+  return TRUE;
+}
+
+/**
+ * @brief Background loader: load the latest model and labels, then swap them in.
+ *
+ * Contexts snapshot the model and labels once per frame, so frames in flight
+ * finish on the ones they started with, and the next frame picks up the new
+ * ones. The old model is freed when the last of those frames drops it. On
+ * failure the current model and labels stay in use.
+ */
+static gpointer
+gst_sscma_yolov5_reload_thread (gpointer data)
+{
+  GstSscmaYolov5 *self = (GstSscmaYolov5 *) data;
+  GstSscmaModel *model = NULL, *old_model;
+  GstSscmaLabels *labels = NULL, *old_labels;
+  gchar *path = NULL, *labels_file, *error = NULL;
+  gdouble load_time = 0;
+  guint generation;
+  gboolean swapped;
+  GstStructure *s;
+
+  GST_OBJECT_LOCK (self);
+  while (self->started) {
+    generation = self->config_generation;
+    GST_OBJECT_UNLOCK (self);
+
+    g_clear_pointer (&path, g_free);
+    g_clear_pointer (&error, g_free);
+    model = gst_sscma_yolov5_open_model (self, &load_time, &path, &error);
+    if (model && !gst_sscma_yolov5_probe_model (self, model, FALSE, &error))
+      g_clear_pointer (&model, gst_sscma_model_unref);
+    if (model && !gst_sscma_yolov5_open_labels (self, &labels, &error))
+      g_clear_pointer (&model, gst_sscma_model_unref);
+
+    GST_OBJECT_LOCK (self);
+    if (generation == self->config_generation)
+      break;
+
+    /* model and labels changed again meanwhile, only the latest ones count */
+    GST_OBJECT_UNLOCK (self);
+    g_clear_pointer (&model, gst_sscma_model_unref);
+    g_clear_pointer (&labels, gst_sscma_labels_unref);
+    GST_OBJECT_LOCK (self);
+  }
+
+  swapped = self->started && model != NULL;
+  if (swapped) {
+    old_model = self->model;
+    old_labels = self->labels;
+    self->model = model;
+    self->labels = labels;
+    self->load_time = load_time;
+  } else {
+    old_model = model;
+    old_labels = labels;
+  }
+  labels_file = g_strdup (self->prop.labels_file);
+  self->reloading = FALSE;
+  GST_OBJECT_UNLOCK (self);
+
+  if (old_model)
+    gst_sscma_model_unref (old_model);
+  if (old_labels)
+    gst_sscma_labels_unref (old_labels);
+
+  if (swapped || error) {
+    if (swapped)
+      GST_INFO_OBJECT (self, "Swapped in model %s, loaded in %.2f ms", path,
+          load_time);
+    else
+      GST_WARNING_OBJECT (self, "Keeping the current model: %s", error);
+
+    s = gst_structure_new ("sscma-model-swap",
+        "success", G_TYPE_BOOLEAN, swapped,
+        "model", G_TYPE_STRING, path,
+        "labels", G_TYPE_STRING, labels_file,
+        "load-time", G_TYPE_DOUBLE, swapped ? load_time : 0.0, NULL);
+    if (error)
+      gst_structure_set (s, "error", G_TYPE_STRING, error, NULL);
+    gst_element_post_message (GST_ELEMENT (self),
+        gst_message_new_element (GST_OBJECT (self), s));
+  }
+
+  g_free (path);
+  g_free (labels_file);
+  g_free (error);
+  return NULL;
+}
+
+/**
+ * @brief Note a change of the model or labels files, and hot-swap them if started.
+ *
+ * At most one reload thread runs, it starts over when the files change again
+ * while it is loading, so setting the model then the labels loads them once.
+ */
+static void
+gst_sscma_yolov5_reload (GstSscmaYolov5 * self)
+{
+  GThread *finished;
+
+  GST_OBJECT_LOCK (self);
+  self->config_generation++;
+  if (!self->started || self->reloading) {
+    GST_OBJECT_UNLOCK (self);
+    return;
+  }
+  finished = self->reload_thread;
+  self->reload_thread = NULL;
+  GST_OBJECT_UNLOCK (self);
+
+  if (finished)
+    g_thread_join (finished);
+
+  GST_OBJECT_LOCK (self);
+  if (self->started && !self->reloading) {
+    self->reloading = TRUE;
+    self->reload_thread = g_thread_new ("sscma-reload",
+        gst_sscma_yolov5_reload_thread, self);
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+/**
+ * @brief Stop hot-swapping, waiting for a model being loaded.
+ */
+static void
+gst_sscma_yolov5_stop_reload (GstSscmaYolov5 * self)
+{
+  GThread *thread;
+
+  GST_OBJECT_LOCK (self);
+  self->started = FALSE;
+  thread = self->reload_thread;
+  self->reload_thread = NULL;
+  GST_OBJECT_UNLOCK (self);
+
+  if (thread)
+    g_thread_join (thread);
+}
+
 /**
  * @brief Load label file into the internal data
  * @param[in/out] l The given ImageLabelData struct.
@@ -325,9 +1249,7 @@ void
 loadImageLabels (const char *label_path, GstSscmaYolov5Properties * prop)
 {
   GError *err = NULL;
-  gchar **_labels;
-  gchar *contents = NULL;
-  gsize len;
+  GstSscmaLabels *labels;
   guint i;
 
   // init labels
@@ -340,43 +1262,104 @@ loadImageLabels (const char *label_path, GstSscmaYolov5Properties * prop)
   prop->total_labels = 0;
   prop->max_word_length = 0;
 
-  /* Read file contents */
-  if (!g_file_get_contents (label_path, &contents, &len, &err)) {
+  labels = gst_sscma_labels_new_from_file (label_path, &err);
+  if (labels == NULL) {
     g_print ("Unable to read file %s with error %s.", label_path, err->message);
     g_clear_error (&err);
     return;
   }
 
-  if (contents[len - 1] == '\n')
-    contents[len - 1] = '\0';
-
-  _labels = g_strsplit (contents, "\n", -1);
-  prop->total_labels = g_strv_length (_labels);
+  prop->total_labels = labels->count;
+  prop->max_word_length = labels->max_word_length;
   prop->labels = g_new0 (char *, prop->total_labels);
-  if (prop->labels == NULL) {
-    g_print ("Failed to allocate memory for label data.");
-    prop->total_labels = 0;
-    goto error;
-  }
+  for (i = 0; i < prop->total_labels; i++)
+    prop->labels[i] = g_strdup (labels->names[i]);
+  gst_sscma_labels_unref (labels);
 
-  for (i = 0; i < prop->total_labels; i++) {
-    prop->labels[i] = g_strdup (_labels[i]);
+  g_print ("Loaded image label file successfully. %u labels loaded.",
+      prop->total_labels);
+}
 
-    len = strlen (_labels[i]);
-    if (len > prop->max_word_length) {
-      prop->max_word_length = len;
-    }
-  }
+/**
+ * @brief Answer an ALLOCATION query for frames that do not go downstream (json output).
+ *
+ * What the default handler gets back is kept. When it proposes no pool, the
+ * frame size of the query caps is, so upstream still sizes its buffers.
+ * @return FALSE if the query caps are not video
+ */
+gboolean
+gst_sscma_propose_allocation (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstCaps *caps = NULL;
+  GstVideoInfo info;
 
-error:
-  g_strfreev (_labels);
-  g_free (contents);
+  gst_query_parse_allocation (query, &caps, NULL);
+  if (caps == NULL || !gst_video_info_from_caps (&info, caps))
+    return FALSE;
+
+  gst_pad_query_default (pad, parent, query);
+  if (gst_query_get_n_allocation_pools (query) == 0)
+    gst_query_add_allocation_pool (query, NULL, GST_VIDEO_INFO_SIZE (&info),
+        0, 0);
+  return TRUE;
+}
+
+/**
+ * @brief Describe a frame mapped with gst_video_frame_map.
+ *
+ * Planes and strides come from the mapped frame, so the padded rows and
+ * plane offsets of a GstVideoMeta are honored.
+ * @return FALSE if the format of the frame is not one the element reads
+ */
+gboolean
+gst_sscma_image_from_video_frame (GstSscmaImage * image,
+    const GstVideoFrame * frame)
+{
+  guint i;
+
+  switch (GST_VIDEO_FRAME_FORMAT (frame)) {
+    case GST_VIDEO_FORMAT_RGB:
+      image->format = GST_SSCMA_PIXEL_RGB;
+      break;
+    case GST_VIDEO_FORMAT_BGR:
+      image->format = GST_SSCMA_PIXEL_BGR;
+      break;
+    case GST_VIDEO_FORMAT_RGBx:
+    case GST_VIDEO_FORMAT_RGBA:
+      image->format = GST_SSCMA_PIXEL_RGBA;
+      break;
+    case GST_VIDEO_FORMAT_BGRx:
+    case GST_VIDEO_FORMAT_BGRA:
+      image->format = GST_SSCMA_PIXEL_BGRA;
+      break;
+    case GST_VIDEO_FORMAT_NV12:
+      image->format = GST_SSCMA_PIXEL_NV12;
+      break;
+    case GST_VIDEO_FORMAT_I420:
+      image->format = GST_SSCMA_PIXEL_I420;
+      break;
+    case GST_VIDEO_FORMAT_YUY2:
+      image->format = GST_SSCMA_PIXEL_YUY2;
+      break;
+    default:
+      return FALSE;
+  }
 
-  if (prop->labels != NULL) {
-    g_print ("Loaded image label file successfully. %u labels loaded.",
-        prop->total_labels);
+  image->width = GST_VIDEO_FRAME_WIDTH (frame);
+  image->height = GST_VIDEO_FRAME_HEIGHT (frame);
+  for (i = 0; i < G_N_ELEMENTS (image->planes); i++) {
+    image->planes[i] = i < GST_VIDEO_FRAME_N_PLANES (frame) ?
+        (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (frame, i) : NULL;
+    image->strides[i] = i < GST_VIDEO_FRAME_N_PLANES (frame) ?
+        GST_VIDEO_FRAME_PLANE_STRIDE (frame, i) : 0;
   }
-  return;
+  image->bt709 =
+      frame->info.colorimetry.matrix == GST_VIDEO_COLOR_MATRIX_BT709;
+  image->full_range =
+      frame->info.colorimetry.range == GST_VIDEO_COLOR_RANGE_0_255;
+
+  return TRUE;
 }
 
 /** @brief Handle "PROP_LABELS" for set-property */
@@ -392,7 +1375,9 @@ _gtfc_setprop_LABELS (GstSscmaYolov5 * priv,
     g_print ("Invalid model provided to the tensor-filter.");
     return 0;
   }
-  loadImageLabels (model_labels, prop);
+  /* read when starting, or by the reload thread while playing */
+  g_free (prop->labels_file);
+  prop->labels_file = g_strdup (model_labels);
   return 0;
 }
 
@@ -429,6 +1414,22 @@ _gtfc_setprop_DIMENSION (GstSscmaYolov5 * priv,
       num_dims = NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT;
     }
 
+    /* a malformed value leaves the current dimensions alone */
+    for (i = 0; i < num_dims; ++i) {
+      tensor_dim dim;
+      guint r = gst_tensor_parse_dimension (str_dims[i], dim);
+      guint k = 0;
+
+      while (k < r && dim[k] > 0)
+        k++;
+      if (r == 0 || k < r) {
+        GST_WARNING_OBJECT (priv, "Invalid dimension \"%s\"",
+            g_value_get_string (value));
+        g_strfreev (str_dims);
+        return -1;
+      }
+    }
+
     for (i = 0; i < num_dims; ++i) {
       rank[i] = gst_tensor_parse_dimension (str_dims[i],
           gst_tensors_info_get_nth_info (info, i)->dimension);
@@ -519,89 +1520,1818 @@ _gtfc_setprop_THRESHOLD (GstSscmaYolov5 * priv,
         }
         for (j = 0; j < noptions; j++)
         {
-           prop->threshold[i] = g_ascii_strtod (options[i], NULL);
+           prop->threshold[j] = g_ascii_strtod (options[j], NULL);
+        }
+        g_strfreev (options);
+      }
+    }
+    g_strfreev (str_thresholds);
+  }
+  return 0;
+}
+
+/**
+ * @brief Get the field of an ncnn option a net option property maps to.
+ * @return NULL if prop_id is not a net option property
+ */
+static bool *
+gst_sscma_yolov5_opt_field (ncnn::Option * opt, guint prop_id)
+{
+  switch (prop_id) {
+    case PROP_USE_FP16_STORAGE:
+      return &opt->use_fp16_storage;
+    case PROP_USE_FP16_ARITHMETIC:
+      return &opt->use_fp16_arithmetic;
+    case PROP_USE_BF16_STORAGE:
+      return &opt->use_bf16_storage;
+    case PROP_USE_PACKING_LAYOUT:
+      return &opt->use_packing_layout;
+    case PROP_USE_WINOGRAD_CONVOLUTION:
+      return &opt->use_winograd_convolution;
+    case PROP_USE_SGEMM_CONVOLUTION:
+      return &opt->use_sgemm_convolution;
+    case PROP_LIGHTMODE:
+      return &opt->lightmode;
+    default:
+      return NULL;
+  }
+}
+
+/** @brief Handle "PROP_INPUT" and "PROP_OUTPUT" for get-property */
+static gchar *
+_gtfc_getprop_DIMENSION (GstSscmaYolov5Properties * prop, const gboolean is_input)
+{
+  GstTensorsInfo *info = is_input ? &prop->input_meta : &prop->output_meta;
+  GString *dims = g_string_new (NULL);
+  guint i;
+
+  for (i = 0; i < info->num_tensors; i++) {
+    gchar *dim = gst_tensor_get_dimension_string (
+        gst_tensors_info_get_nth_info (info, i)->dimension);
+
+    if (i > 0)
+      g_string_append (dims, ",");
+    g_string_append (dims, dim);
+    g_free (dim);
+  }
+  return g_string_free (dims, FALSE);
+}
+
+/** @brief Handle "PROP_OUTPUTTYPE" for get-property */
+static gchar *
+_gtfc_getprop_TYPE (GstSscmaYolov5Properties * prop)
+{
+  GstTensorsInfo *info = &prop->output_meta;
+  GString *types = g_string_new (NULL);
+  guint i;
+
+  for (i = 0; i < info->num_tensors; i++) {
+    if (i > 0)
+      g_string_append (types, ",");
+    g_string_append (types, GST_STR_NULL (gst_tensor_get_type_string (
+                gst_tensors_info_get_nth_info (info, i)->type)));
+  }
+  return g_string_free (types, FALSE);
+}
+
+/** @brief Handle "PROP_THRESHOLD" for get-property */
+static gchar *
+_gtfc_getprop_THRESHOLD (GstSscmaYolov5Properties * prop)
+{
+  gchar score[G_ASCII_DTOSTR_BUF_SIZE], iou[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_ascii_formatd (score, sizeof (score), "%g", prop->threshold[0]);
+  g_ascii_formatd (iou, sizeof (iou), "%g", prop->threshold[1]);
+  return g_strdup_printf ("%s:%s", score, iou);
+}
+
+/**
+ * @brief Read one ROI of a JSON array, {"x":..,"y":..,"width":..,"height":..} or [x, y, w, h].
+ */
+static gboolean
+_gtfc_parse_json_roi (JsonNode * node, GstSscmaTile * roi)
+{
+  if (JSON_NODE_HOLDS_OBJECT (node)) {
+    JsonObject *object = json_node_get_object (node);
+
+    if (!json_object_has_member (object, "x")
+        || !json_object_has_member (object, "y")
+        || !json_object_has_member (object, "width")
+        || !json_object_has_member (object, "height"))
+      return FALSE;
+    roi->x = json_object_get_int_member (object, "x");
+    roi->y = json_object_get_int_member (object, "y");
+    roi->width = json_object_get_int_member (object, "width");
+    roi->height = json_object_get_int_member (object, "height");
+    return TRUE;
+  }
+
+  if (JSON_NODE_HOLDS_ARRAY (node)) {
+    JsonArray *array = json_node_get_array (node);
+
+    if (json_array_get_length (array) != 4)
+      return FALSE;
+    roi->x = json_array_get_int_element (array, 0);
+    roi->y = json_array_get_int_element (array, 1);
+    roi->width = json_array_get_int_element (array, 2);
+    roi->height = json_array_get_int_element (array, 3);
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/**
+ * @brief Parse ROIs, "x:y:w:h;x:y:w:h" or a JSON array of rectangles, an empty string for none.
+ * @return FALSE if str is invalid, rois is then left empty
+ */
+static gboolean
+_gtfc_parse_ROI (const gchar * str, GArray * rois)
+{
+  GstSscmaTile roi;
+  gboolean ok = TRUE;
+  guint i;
+
+  g_array_set_size (rois, 0);
+  if (str == NULL)
+    return TRUE;
+  while (g_ascii_isspace (*str))
+    str++;
+
+  if (*str == '[' || *str == '{') {
+    JsonParser *parser = json_parser_new ();
+    JsonNode *root;
+
+    if (!json_parser_load_from_data (parser, str, -1, NULL)) {
+      g_object_unref (parser);
+      return FALSE;
+    }
+    root = json_parser_get_root (parser);
+    if (JSON_NODE_HOLDS_OBJECT (root)) {
+      ok = _gtfc_parse_json_roi (root, &roi);
+      if (ok)
+        g_array_append_val (rois, roi);
+    } else if (JSON_NODE_HOLDS_ARRAY (root)) {
+      JsonArray *array = json_node_get_array (root);
+
+      /* a single [x, y, w, h] or a list of rectangles */
+      if (json_array_get_length (array) == 4
+          && JSON_NODE_HOLDS_VALUE (json_array_get_element (array, 0))) {
+        ok = _gtfc_parse_json_roi (root, &roi);
+        if (ok)
+          g_array_append_val (rois, roi);
+      } else {
+        for (i = 0; ok && i < json_array_get_length (array); i++) {
+          ok = _gtfc_parse_json_roi (json_array_get_element (array, i), &roi);
+          if (ok)
+            g_array_append_val (rois, roi);
         }
       }
+    } else {
+      ok = FALSE;
+    }
+    g_object_unref (parser);
+  } else if (*str != '\0') {
+    gchar **rects = g_strsplit (str, ";", -1);
+
+    for (i = 0; ok && rects[i]; i++) {
+      if (g_strstrip (rects[i])[0] == '\0')
+        continue;
+      ok = sscanf (rects[i], "%d:%d:%d:%d", &roi.x, &roi.y, &roi.width,
+          &roi.height) == 4;
+      if (ok)
+        g_array_append_val (rois, roi);
+    }
+    g_strfreev (rects);
+  }
+
+  /* bounded, so that x + width and y + height cannot overflow */
+  for (i = 0; ok && i < rois->len; i++) {
+    const GstSscmaTile *r = &g_array_index (rois, GstSscmaTile, i);
+    ok = r->x >= 0 && r->y >= 0 && r->width > 0 && r->height > 0
+        && r->x <= G_MAXINT / 2 && r->y <= G_MAXINT / 2
+        && r->width <= G_MAXINT / 2 && r->height <= G_MAXINT / 2;
+  }
+  if (ok && rois->len > GST_SSCMA_MAX_TILES)
+    ok = FALSE;
+  if (!ok)
+    g_array_set_size (rois, 0);
+  return ok;
+}
+
+/**
+ * @brief Parse a roi string into the ROIs to use, warn if it is invalid.
+ * @return -1 if str is invalid
+ */
+static gint
+_gtfc_parse_ROI_checked (GstSscmaYolov5 * priv, const gchar * str,
+    GArray * rois)
+{
+  if (!_gtfc_parse_ROI (str, rois)) {
+    GST_WARNING_OBJECT (priv, "Invalid roi \"%s\", keeping the current ones",
+        str);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Replace the ROIs. Must be called with queue_lock held.
+ */
+static void
+_gtfc_set_ROI_locked (GstSscmaYolov5 * priv, const GArray * rois)
+{
+  g_array_set_size (priv->rois, rois->len);
+  if (rois->len)
+    memcpy (priv->rois->data, rois->data, rois->len * sizeof (GstSscmaTile));
+}
+
+/** @brief Handle "PROP_ROI" for set-property */
+static gint
+_gtfc_setprop_ROI (GstSscmaYolov5 * priv, const gchar * str)
+{
+  GArray *rois = g_array_new (FALSE, TRUE, sizeof (GstSscmaTile));
+  gint status = _gtfc_parse_ROI_checked (priv, str, rois);
+
+  if (status == 0) {
+    g_mutex_lock (&priv->queue_lock);
+    _gtfc_set_ROI_locked (priv, rois);
+    g_mutex_unlock (&priv->queue_lock);
+  }
+  g_array_free (rois, TRUE);
+  return status;
+}
+
+/** @brief Handle "PROP_ROI" for get-property */
+static gchar *
+_gtfc_getprop_ROI (GstSscmaYolov5 * priv)
+{
+  GString *str = g_string_new (NULL);
+  guint i;
+
+  g_mutex_lock (&priv->queue_lock);
+  for (i = 0; i < priv->rois->len; i++) {
+    const GstSscmaTile *r = &g_array_index (priv->rois, GstSscmaTile, i);
+    g_string_append_printf (str, "%s%d:%d:%d:%d", i ? ";" : "", r->x, r->y,
+        r->width, r->height);
+  }
+  g_mutex_unlock (&priv->queue_lock);
+
+  return g_string_free (str, FALSE);
+}
+
+/**
+ * @brief Parse yolov5-raw anchors: "w,h,w,h,w,h;..." one set per head, smallest stride first.
+ * @return FALSE, keeping the current anchors, if str is malformed
+ */
+static gboolean
+_gtfc_parse_anchors (GstSscmaYolov5Properties * prop, const gchar * str)
+{
+  gfloat anchors[GST_SSCMA_MAX_OUTPUTS][2 * GST_SSCMA_ANCHORS_PER_HEAD];
+  gchar **sets;
+  guint num_sets, i, j;
+  gboolean ok;
+
+  if (str == NULL)
+    str = DEFAULT_ANCHORS;
+  sets = g_strsplit (str, ";", -1);
+  num_sets = g_strv_length (sets);
+  ok = num_sets > 0 && num_sets <= GST_SSCMA_MAX_OUTPUTS;
+
+  for (i = 0; ok && i < num_sets; i++) {
+    gchar **values = g_strsplit (sets[i], ",", -1);
+
+    ok = g_strv_length (values) == 2 * GST_SSCMA_ANCHORS_PER_HEAD;
+    for (j = 0; ok && j < 2 * GST_SSCMA_ANCHORS_PER_HEAD; j++) {
+      gchar *end;
+      anchors[i][j] = (gfloat) g_ascii_strtod (values[j], &end);
+      ok = end != values[j] && *end == '\0' && anchors[i][j] > 0.f;
+    }
+    g_strfreev (values);
+  }
+  g_strfreev (sets);
+
+  if (!ok)
+    return FALSE;
+  memcpy (prop->anchors, anchors, sizeof (anchors));
+  prop->num_anchor_sets = num_sets;
+  return TRUE;
+}
+
+/** @brief Handle "PROP_ANCHORS" for get-property */
+static gchar *
+_gtfc_getprop_anchors (GstSscmaYolov5Properties * prop)
+{
+  GString *str = g_string_new (NULL);
+  guint i, j;
+
+  for (i = 0; i < prop->num_anchor_sets; i++) {
+    for (j = 0; j < 2 * GST_SSCMA_ANCHORS_PER_HEAD; j++)
+      g_string_append_printf (str, "%s%g", j ? "," : (i ? ";" : ""),
+          prop->anchors[i][j]);
+  }
+
+  return g_string_free (str, FALSE);
+}
+
+/** @brief Handle "PROP_CPU_MASK" and "PROP_STREAMING_CPU_MASK" for set-property */
+static gint
+_gtfc_setprop_CPU_MASK (GstSscmaYolov5 * priv, gchar ** mask, const gchar * str)
+{
+  ncnn::CpuSet set;
+
+  if (str && str[0] != '\0' && !gst_sscma_cpu_mask_parse (str, set)) {
+    GST_WARNING_OBJECT (priv, "Invalid CPU mask \"%s\", keeping the current one",
+        str);
+    return -1;
+  }
+
+  g_mutex_lock (&priv->queue_lock);
+  g_free (*mask);
+  *mask = (str && str[0] != '\0') ? g_strdup (str) : NULL;
+  priv->affinity_generation++;
+  g_mutex_unlock (&priv->queue_lock);
+  return 0;
+}
+
+static void
+gst_sscma_yolov5_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (object);
+  GstSscmaYolov5Properties *prop;
+  gint status = 0;
+  // UNUSED (pspec);
+
+  prop = &self->prop;
+  switch (prop_id) {
+    // input model :mode=xxx,xxx (can be multiple)
+    // the model and labels can change while playing, they are then hot-swapped
+    case PROP_MODEL:
+      GST_OBJECT_LOCK (self);
+      status = _gtfc_setprop_MODEL (self, prop, value);
+      GST_OBJECT_UNLOCK (self);
+      gst_sscma_yolov5_reload (self);
+      break;
+    // label file path :labels=xxx
+    case PROP_MODE_LABELS:
+      GST_OBJECT_LOCK (self);
+      status = _gtfc_setprop_LABELS (self, prop, value);
+      GST_OBJECT_UNLOCK (self);
+      gst_sscma_yolov5_reload (self);
+      break;
+    // int8 quantized model :int8-model=xxx.bin,xxx.param
+    case PROP_INT8_MODEL:
+      GST_OBJECT_LOCK (self);
+      status = _gtfc_setprop_INT8_MODEL (prop, value);
+      GST_OBJECT_UNLOCK (self);
+      gst_sscma_yolov5_reload (self);
+      break;
+    case PROP_INT8_TABLE:
+      GST_OBJECT_LOCK (self);
+      g_free (prop->int8_table);
+      prop->int8_table = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_MMAP:
+      GST_OBJECT_LOCK (self);
+      prop->use_mmap = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_WARMUP_RUNS:
+      self->warmup_runs = g_value_get_uint (value);
+      break;
+    case PROP_LETTERBOX:
+      prop->letterbox = g_value_get_boolean (value);
+      break;
+    // output head, picked up by the next frame: decoder=yolov8
+    case PROP_DECODER:
+      GST_OBJECT_LOCK (self);
+      prop->decoder = (GstSscmaDecoder) g_value_get_enum (value);
+      self->head_generation++;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_INPUT_BLOB:
+      GST_OBJECT_LOCK (self);
+      g_free (prop->input_blob);
+      prop->input_blob = g_value_dup_string (value);
+      if (prop->input_blob == NULL)
+        prop->input_blob = g_strdup (DEFAULT_INPUT_BLOB);
+      self->head_generation++;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_OUTPUT_BLOBS:
+      GST_OBJECT_LOCK (self);
+      g_strfreev (prop->output_blobs);
+      prop->output_blobs = g_strsplit (g_value_get_string (value) ?
+          g_value_get_string (value) : DEFAULT_OUTPUT_BLOBS, ",", -1);
+      self->head_generation++;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_ANCHORS:
+      GST_OBJECT_LOCK (self);
+      if (!_gtfc_parse_anchors (prop, g_value_get_string (value)))
+        status = -1;
+      self->head_generation++;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_MAX_SCORE:
+      GST_OBJECT_LOCK (self);
+      prop->max_score = g_value_get_float (value);
+      self->head_generation++;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    // Input video size: input=320:320:3
+    case PROP_INPUT:
+      status = _gtfc_setprop_DIMENSION (self, value, TRUE);
+      if (status == 0)
+        prop->input_configured = TRUE;
+      break;
+    // Model output size: output=85:6300:1:1 
+    case PROP_OUTPUT:
+      status = _gtfc_setprop_DIMENSION (self, value, FALSE);
+      if (status == 0)
+        prop->output_configured = TRUE;
+      break;
+    // TODO:input format: inputformat=RGB
+    case PROP_INPUTFORMAT:
+      // status = _gtfc_setprop_FORMAT (self, value);
+      break;
+    // Input type: inputtype=float32
+    case PROP_INPUTTYPE:
+      status = _gtfc_setprop_TYPE (self, value, TRUE);
+      break;
+    // Output type: outputtype=float32
+    case PROP_OUTPUTTYPE:
+      status = _gtfc_setprop_TYPE (self, value, FALSE);
+      break;
+    // Output result threshold and block diagram threshold: threshold=0.5:0.3
+    case PROP_THRESHOLD:
+      status = _gtfc_setprop_THRESHOLD (self, value);
+      break;
+    // Configuring thread count: numthreads=1
+    case PROP_NUMTHREADS:
+      status = 0;
+      if (g_value_get_int (value) > 0)
+        prop->num_threads = g_value_get_int (value);
+      else
+        status = -1;
+      break;
+    case PROP_IS_OUTPUT_SCALED:
+      self->prop.is_output_scaled = g_value_get_boolean (value);
+      break;
+    case PROP_ASYNC:
+      g_mutex_lock (&self->queue_lock);
+      self->async = g_value_get_boolean (value);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_MAX_QUEUE_SIZE:
+      g_mutex_lock (&self->queue_lock);
+      self->max_queue_size = g_value_get_uint (value);
+      g_cond_broadcast (&self->queue_cond);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_DROP_POLICY:
+      g_mutex_lock (&self->queue_lock);
+      self->drop_policy = (GstSscmaYolov5DropPolicy) g_value_get_enum (value);
+      g_cond_broadcast (&self->queue_cond);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_INFLIGHT:
+      g_mutex_lock (&self->queue_lock);
+      self->inflight = g_value_get_uint (value);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_INTERVAL:
+      g_mutex_lock (&self->queue_lock);
+      self->interval = g_value_get_uint (value);
+      self->current_interval = MIN (self->current_interval, self->interval);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_MAX_RATE:
+      g_mutex_lock (&self->queue_lock);
+      self->max_rate = g_value_get_double (value);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_ADAPTIVE_INTERVAL:
+      g_mutex_lock (&self->queue_lock);
+      self->adaptive_interval = g_value_get_boolean (value);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_MOTION_THRESHOLD:
+      g_mutex_lock (&self->queue_lock);
+      self->motion_threshold = g_value_get_double (value);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_MOTION_PIXEL_THRESHOLD:
+      g_mutex_lock (&self->queue_lock);
+      self->motion_pixel_threshold = g_value_get_uint (value);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_TILE_SIZE:
+      g_mutex_lock (&self->queue_lock);
+      self->tile_size = g_value_get_uint (value);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_TILE_OVERLAP:
+      g_mutex_lock (&self->queue_lock);
+      self->tile_overlap = g_value_get_double (value);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_MAX_TILES:
+      g_mutex_lock (&self->queue_lock);
+      self->max_tiles = g_value_get_uint (value);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_TILE_GLOBAL:
+      g_mutex_lock (&self->queue_lock);
+      self->tile_global = g_value_get_boolean (value);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_ROI:
+      status = _gtfc_setprop_ROI (self, g_value_get_string (value));
+      break;
+    case PROP_POWERSAVE:
+      g_mutex_lock (&self->queue_lock);
+      self->powersave = (GstSscmaYolov5Powersave) g_value_get_enum (value);
+      self->affinity_generation++;
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_CPU_MASK:
+      status = _gtfc_setprop_CPU_MASK (self, &self->cpu_mask,
+          g_value_get_string (value));
+      break;
+    case PROP_STREAMING_CPU_MASK:
+      status = _gtfc_setprop_CPU_MASK (self, &self->streaming_cpu_mask,
+          g_value_get_string (value));
+      break;
+    // ncnn net options, used by the next model load: use-fp16-storage=false
+    case PROP_USE_FP16_STORAGE:
+    case PROP_USE_FP16_ARITHMETIC:
+    case PROP_USE_BF16_STORAGE:
+    case PROP_USE_PACKING_LAYOUT:
+    case PROP_USE_WINOGRAD_CONVOLUTION:
+    case PROP_USE_SGEMM_CONVOLUTION:
+    case PROP_LIGHTMODE:
+      GST_OBJECT_LOCK (self);
+      *gst_sscma_yolov5_opt_field (&prop->opt, prop_id) =
+          g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  if(status != 0){
+    g_print ("Invalid param, please check your param.\n");
+  }
+}
+
+static void
+gst_sscma_yolov5_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (object);
+  GstSscmaYolov5Properties *prop = &self->prop;
+
+  switch (prop_id) {
+    case PROP_MODEL:
+      GST_OBJECT_LOCK (self);
+      g_value_take_string (value, prop->model_files ?
+          g_strjoinv (",", (gchar **) prop->model_files) : NULL);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_MODE_LABELS:
+      GST_OBJECT_LOCK (self);
+      g_value_set_string (value, prop->labels_file);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_INT8_MODEL:
+      GST_OBJECT_LOCK (self);
+      g_value_take_string (value, prop->int8_model_files ?
+          g_strjoinv (",", (gchar **) prop->int8_model_files) : NULL);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_INT8_TABLE:
+      GST_OBJECT_LOCK (self);
+      g_value_set_string (value, prop->int8_table);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_MMAP:
+      GST_OBJECT_LOCK (self);
+      g_value_set_boolean (value, prop->use_mmap);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_WARMUP_RUNS:
+      g_value_set_uint (value, self->warmup_runs);
+      break;
+    case PROP_LETTERBOX:
+      g_value_set_boolean (value, prop->letterbox);
+      break;
+    case PROP_DECODER:
+      GST_OBJECT_LOCK (self);
+      g_value_set_enum (value, prop->decoder);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_INPUT_BLOB:
+      GST_OBJECT_LOCK (self);
+      g_value_set_string (value, prop->input_blob);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_OUTPUT_BLOBS:
+      GST_OBJECT_LOCK (self);
+      g_value_take_string (value, g_strjoinv (",", prop->output_blobs));
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_ANCHORS:
+      GST_OBJECT_LOCK (self);
+      g_value_take_string (value, _gtfc_getprop_anchors (prop));
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_MAX_SCORE:
+      GST_OBJECT_LOCK (self);
+      g_value_set_float (value, prop->max_score);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_LOAD_TIME:
+      GST_OBJECT_LOCK (self);
+      g_value_set_double (value, self->load_time);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_WARMUP_TIME:
+      GST_OBJECT_LOCK (self);
+      g_value_set_double (value, self->warmup_time);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_INPUT:
+      g_value_take_string (value, _gtfc_getprop_DIMENSION (prop, TRUE));
+      break;
+    case PROP_OUTPUT:
+      g_value_take_string (value, _gtfc_getprop_DIMENSION (prop, FALSE));
+      break;
+    case PROP_OUTPUTTYPE:
+      g_value_take_string (value, _gtfc_getprop_TYPE (prop));
+      break;
+    case PROP_THRESHOLD:
+      g_value_take_string (value, _gtfc_getprop_THRESHOLD (prop));
+      break;
+    case PROP_NUMTHREADS:
+      g_value_set_int (value, prop->num_threads);
+      break;
+    case PROP_IS_OUTPUT_SCALED:
+      g_value_set_boolean (value, prop->is_output_scaled);
+      break;
+    case PROP_USE_FP16_STORAGE:
+    case PROP_USE_FP16_ARITHMETIC:
+    case PROP_USE_BF16_STORAGE:
+    case PROP_USE_PACKING_LAYOUT:
+    case PROP_USE_WINOGRAD_CONVOLUTION:
+    case PROP_USE_SGEMM_CONVOLUTION:
+    case PROP_LIGHTMODE:
+      /* the loaded net's options are the effective ones */
+      GST_OBJECT_LOCK (self);
+      g_value_set_boolean (value, *gst_sscma_yolov5_opt_field (self->model ?
+              &self->model->net.opt : &prop->opt, prop_id));
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_ASYNC:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_boolean (value, self->async);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_MAX_QUEUE_SIZE:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_uint (value, self->max_queue_size);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_DROP_POLICY:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_enum (value, self->drop_policy);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_DROPPED:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_uint64 (value, self->dropped);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_INFLIGHT:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_uint (value, self->inflight);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_INTERVAL:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_uint (value, self->interval);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_MAX_RATE:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_double (value, self->max_rate);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_ADAPTIVE_INTERVAL:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_boolean (value, self->adaptive_interval);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_REUSED:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_uint64 (value, self->reused);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_MOTION_THRESHOLD:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_double (value, self->motion_threshold);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_MOTION_PIXEL_THRESHOLD:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_uint (value, self->motion_pixel_threshold);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_MOTION_SKIPPED:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_uint64 (value, self->motion_skipped);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_TILE_SIZE:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_uint (value, self->tile_size);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_TILE_OVERLAP:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_double (value, self->tile_overlap);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_MAX_TILES:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_uint (value, self->max_tiles);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_TILE_GLOBAL:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_boolean (value, self->tile_global);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_ROI:
+      g_value_take_string (value, _gtfc_getprop_ROI (self));
+      break;
+    case PROP_POWERSAVE:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_enum (value, self->powersave);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_CPU_MASK:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_string (value, self->cpu_mask);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_STREAMING_CPU_MASK:
+      g_mutex_lock (&self->queue_lock);
+      g_value_set_string (value, self->streaming_cpu_mask);
+      g_mutex_unlock (&self->queue_lock);
+      break;
+    case PROP_ALLOCATIONS:
+      g_value_set_uint (value, g_atomic_int_get (&self->allocations));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/**
+ * @brief Drop every queued buffer and event. Must be called with queue_lock held.
+ */
+static void
+gst_sscma_yolov5_clear_queue (GstSscmaYolov5 * self)
+{
+  GstMiniObject *item;
+
+  while ((item = (GstMiniObject *) g_queue_pop_head (&self->queue)))
+    gst_mini_object_unref (item);
+  self->queued_buffers = 0;
+}
+
+/**
+ * @brief Drop the oldest queued buffer, events stay. Must be called with queue_lock held.
+ */
+static void
+gst_sscma_yolov5_drop_oldest (GstSscmaYolov5 * self)
+{
+  GList *l;
+
+  for (l = self->queue.head; l; l = l->next) {
+    if (GST_IS_BUFFER (l->data)) {
+      GST_LOG_OBJECT (self, "Queue full, dropping oldest frame %" GST_PTR_FORMAT,
+          l->data);
+      gst_buffer_unref (GST_BUFFER_CAST (l->data));
+      g_queue_delete_link (&self->queue, l);
+      self->queued_buffers--;
+      self->dropped++;
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Wait until the worker has handled everything queued so far.
+ */
+static void
+gst_sscma_yolov5_drain (GstSscmaYolov5 * self)
+{
+  g_mutex_lock (&self->queue_lock);
+  while (self->running_async && !self->flushing
+      && (!g_queue_is_empty (&self->queue) || self->busy > 0))
+    g_cond_wait (&self->queue_cond, &self->queue_lock);
+  g_mutex_unlock (&self->queue_lock);
+}
+
+/**
+ * @brief Forget the last detections, so the next frame is inferred. Must be called with queue_lock held.
+ */
+static void
+gst_sscma_yolov5_reset_interval (GstSscmaYolov5 * self)
+{
+  self->inference_scheduled = FALSE;
+  self->frames_since_inference = 0;
+  self->last_inference_ts = GST_CLOCK_TIME_NONE;
+  self->current_interval = 1;
+  self->have_motion_reference = FALSE;
+  g_array_set_size (self->last_results, 0);
+  /* inferences still running store nothing */
+  self->stored_inference = self->scheduled_inference;
+}
+
+/**
+ * @brief Build the luma thumbnail of a frame, GST_SSCMA_MOTION_SIZE bytes.
+ * @return FALSE if the frame cannot be read
+ */
+static gboolean
+gst_sscma_yolov5_motion_thumbnail (GstSscmaYolov5 * self, GstBuffer * buf,
+    guint8 * thumbnail)
+{
+  GstSscmaImage image;
+  GstVideoFrame frame;
+
+  if (!gst_video_frame_map (&frame, &self->vinfo, buf, GST_MAP_READ))
+    return FALSE;
+  if (gst_sscma_image_from_video_frame (&image, &frame))
+    gst_sscma_motion_thumbnail (&image, thumbnail);
+  gst_video_frame_unmap (&frame);
+  return TRUE;
+}
+
+/**
+ * @brief Decide if a frame is inferred or reuses the last detections.
+ *
+ * Must be called with queue_lock held, in stream order: from the chain
+ * function in sync mode, when a worker takes the frame in async mode. The
+ * motion thumbnail, only built when the interval and the rate let the frame
+ * be inferred, is computed without the lock; frames taken meanwhile wait for
+ * their turn to be scheduled.
+ */
+static gboolean
+gst_sscma_yolov5_schedule_inference (GstSscmaYolov5 * self, GstBuffer * buf)
+{
+  GstClockTime ts = GST_BUFFER_PTS (buf);
+  guint64 ticket = self->schedule_ticket++;
+  guint8 thumbnail[GST_SSCMA_MOTION_SIZE];
+  gboolean reuse = FALSE, motion = FALSE;
+  guint interval;
+
+  while (self->schedule_turn != ticket)
+    g_cond_wait (&self->queue_cond, &self->queue_lock);
+
+  if (!GST_CLOCK_TIME_IS_VALID (ts))
+    ts = g_get_monotonic_time () * GST_USECOND;
+
+  interval = self->adaptive_interval ? self->current_interval : self->interval;
+  if (self->inference_scheduled) {
+    reuse = self->frames_since_inference + 1 < interval;
+
+    if (!reuse && self->max_rate > 0
+        && GST_CLOCK_TIME_IS_VALID (self->last_inference_ts)
+        && ts > self->last_inference_ts)
+      reuse = ts - self->last_inference_ts < GST_SECOND / self->max_rate;
+  }
+
+  if (!reuse && self->motion_threshold > 0) {
+    g_mutex_unlock (&self->queue_lock);
+    motion = gst_sscma_yolov5_motion_thumbnail (self, buf, thumbnail);
+    g_mutex_lock (&self->queue_lock);
+  }
+
+  /* against the last inferred frame, so that slow changes add up */
+  if (!reuse && motion && self->inference_scheduled
+      && self->have_motion_reference) {
+    guint changed = gst_sscma_motion_changed (thumbnail,
+        self->motion_reference, GST_SSCMA_MOTION_SIZE,
+        (guint8) self->motion_pixel_threshold);
+
+    if (changed < self->motion_threshold * GST_SSCMA_MOTION_SIZE) {
+      self->motion_skipped++;
+      reuse = TRUE;
+    }
+  }
+
+  self->schedule_turn++;
+  g_cond_broadcast (&self->queue_cond);
+
+  if (reuse) {
+    self->frames_since_inference++;
+    self->reused++;
+    return FALSE;
+  }
+
+  if (motion) {
+    memcpy (self->motion_reference, thumbnail, GST_SSCMA_MOTION_SIZE);
+    self->have_motion_reference = TRUE;
+  }
+  self->inference_scheduled = TRUE;
+  self->scheduled_inference++;
+  self->frames_since_inference = 0;
+  self->last_inference_ts = ts;
+  return TRUE;
+}
+
+/**
+ * @brief Keep the detections of an inferred frame for the frames that reuse them,
+ * and adapt the interval to how much they changed.
+ *
+ * With several frames in flight inferences can finish out of order, the
+ * detections of a frame older than the stored ones are dropped.
+ * @param inference scheduled_inference of the frame
+ */
+static void
+gst_sscma_yolov5_store_results (GstSscmaYolov5 * self, guint64 inference,
+    GArray * results)
+{
+  g_mutex_lock (&self->queue_lock);
+  if (inference <= self->stored_inference) {
+    g_mutex_unlock (&self->queue_lock);
+    return;
+  }
+  self->stored_inference = inference;
+  if (self->adaptive_interval) {
+    gfloat change = gst_sscma_results_change (self->last_results, results);
+
+    if (change > ADAPTIVE_CHANGE_HIGH)
+      self->current_interval = MAX (1U, self->current_interval / 2);
+    else if (change < ADAPTIVE_CHANGE_LOW)
+      self->current_interval = MIN (self->interval, self->current_interval + 1);
+    GST_LOG_OBJECT (self, "Detections changed by %.2f, interval %u", change,
+        self->current_interval);
+  }
+  g_array_set_size (self->last_results, results->len);
+  if (results->len)
+    memcpy (self->last_results->data, results->data,
+        results->len * sizeof (detectedObject));
+  g_mutex_unlock (&self->queue_lock);
+}
+
+/**
+ * @brief Copy the last detections, for a frame that is not inferred.
+ */
+static void
+gst_sscma_yolov5_load_results (GstSscmaYolov5 * self, GArray * results)
+{
+  g_mutex_lock (&self->queue_lock);
+  g_array_set_size (results, self->last_results->len);
+  if (results->len)
+    memcpy (results->data, self->last_results->data,
+        results->len * sizeof (detectedObject));
+  g_mutex_unlock (&self->queue_lock);
+}
+
+/**
+ * @brief Set up the allocator pools and reusable arrays of an inference context.
+ */
+static void
+gst_sscma_yolov5_context_init (GstSscmaYolov5Context * ctx,
+    GstSscmaYolov5 * self, int num_threads)
+{
+  ctx->self = self;
+  ctx->num_threads = num_threads;
+  ctx->blob_allocator = new GstSscmaCountingAllocator (FALSE);
+  ctx->workspace_allocator = new GstSscmaCountingAllocator (TRUE);
+  ctx->results = g_array_new (FALSE, TRUE, sizeof (detectedObject));
+  ctx->infer_time = g_array_sized_new (FALSE, TRUE, sizeof (guint32), 3);
+}
+
+/**
+ * @brief Release everything an inference context holds.
+ */
+static void
+gst_sscma_yolov5_context_clear (GstSscmaYolov5Context * ctx)
+{
+  /* blobs go back to the pools before the pools go away */
+  delete ctx->ex;
+  ctx->ex = NULL;
+  ctx->in.release ();
+  gst_sscma_resize_table_clear (&ctx->resize);
+  for (guint i = 0; i < GST_SSCMA_MAX_OUTPUTS; i++)
+    ctx->outs[i].release ();
+  if (ctx->model)
+    gst_sscma_model_unref (ctx->model);
+  ctx->model = NULL;
+  if (ctx->labels)
+    gst_sscma_labels_unref (ctx->labels);
+  ctx->labels = NULL;
+  g_free (ctx->input_blob);
+  g_strfreev (ctx->output_blobs);
+  ctx->input_blob = NULL;
+  ctx->output_blobs = NULL;
+  ctx->head_generation = 0;
+
+  delete ctx->blob_allocator;
+  delete ctx->workspace_allocator;
+  ctx->blob_allocator = ctx->workspace_allocator = NULL;
+
+  g_array_free (ctx->results, TRUE);
+  g_array_free (ctx->infer_time, TRUE);
+  ctx->results = ctx->infer_time = NULL;
+
+  if (ctx->tile_jobs) {
+    for (guint i = 0; i <= GST_SSCMA_MAX_TILES; i++) {
+      g_array_free (ctx->tile_jobs[i].results, TRUE);
+      gst_sscma_resize_table_clear (&ctx->tile_jobs[i].resize);
+    }
+    g_free (ctx->tile_jobs);
+    ctx->tile_jobs = NULL;
+  }
+}
+
+/**
+ * @brief Copy the output head properties into the context if they changed.
+ */
+static void
+gst_sscma_yolov5_context_sync_head (GstSscmaYolov5Context * ctx)
+{
+  GstSscmaYolov5 *self = ctx->self;
+  GstSscmaYolov5Properties *prop = &self->prop;
+
+  GST_OBJECT_LOCK (self);
+  if (ctx->head_generation != self->head_generation) {
+    ctx->head_generation = self->head_generation;
+    ctx->decoder = prop->decoder;
+    g_free (ctx->input_blob);
+    ctx->input_blob = g_strdup (prop->input_blob);
+    g_strfreev (ctx->output_blobs);
+    ctx->output_blobs = g_strdupv (prop->output_blobs);
+    ctx->num_outs = MIN (g_strv_length (ctx->output_blobs),
+        GST_SSCMA_MAX_OUTPUTS);
+    memcpy (ctx->anchors, prop->anchors, sizeof (ctx->anchors));
+    ctx->num_anchor_sets = prop->num_anchor_sets;
+    ctx->max_score = prop->max_score;
+    ctx->decode = NULL;
+    ctx->decode_selected = FALSE;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+/**
+ * @brief Point the context at a model and its labels, recreating the extractor if the model changed.
+ */
+static void
+gst_sscma_yolov5_context_bind (GstSscmaYolov5Context * ctx,
+    GstSscmaModel * model, GstSscmaLabels * labels)
+{
+  if (labels != ctx->labels) {
+    if (ctx->labels)
+      gst_sscma_labels_unref (ctx->labels);
+    ctx->labels = labels ? gst_sscma_labels_ref (labels) : NULL;
+  }
+
+  if (model == ctx->model)
+    return;
+
+  delete ctx->ex;
+  for (guint i = 0; i < GST_SSCMA_MAX_OUTPUTS; i++)
+    ctx->outs[i].release ();
+  if (ctx->model)
+    gst_sscma_model_unref (ctx->model);
+  ctx->model = gst_sscma_model_ref (model);
+
+  ctx->ex = new ncnn::Extractor (model->net.create_extractor ());
+  ctx->ex->set_num_threads (ctx->num_threads);
+  ctx->ex->set_blob_allocator (ctx->blob_allocator);
+  ctx->ex->set_workspace_allocator (ctx->workspace_allocator);
+}
+
+/**
+ * @brief Make sure the context has an extractor on the element's current model.
+ *
+ * Called once per frame, the frame then runs on that model and its labels
+ * even if they are hot-swapped meanwhile.
+ * @return FALSE if no model is loaded
+ */
+static gboolean
+gst_sscma_yolov5_context_prepare (GstSscmaYolov5Context * ctx)
+{
+  GstSscmaYolov5 *self = ctx->self;
+  GstSscmaModel *model = NULL;
+  GstSscmaLabels *labels = NULL;
+
+  gst_sscma_yolov5_context_sync_head (ctx);
+
+  GST_OBJECT_LOCK (self);
+  if (self->model == NULL) {
+    GST_OBJECT_UNLOCK (self);
+    return FALSE;
+  }
+  if (self->model == ctx->model && self->labels == ctx->labels) {
+    GST_OBJECT_UNLOCK (self);
+    return TRUE;
+  }
+  /* keep them alive once the lock is released, a swap may drop them */
+  model = gst_sscma_model_ref (self->model);
+  if (self->labels)
+    labels = gst_sscma_labels_ref (self->labels);
+  GST_OBJECT_UNLOCK (self);
+
+  gst_sscma_yolov5_context_bind (ctx, model, labels);
+  gst_sscma_model_unref (model);
+  if (labels)
+    gst_sscma_labels_unref (labels);
+
+  return TRUE;
+}
+
+/**
+ * @brief Reset the heap allocation counters of a context's pools.
+ */
+static void
+gst_sscma_yolov5_context_reset_allocations (GstSscmaYolov5Context * ctx)
+{
+  g_atomic_int_set (&ctx->blob_allocator->allocations, 0);
+  g_atomic_int_set (&ctx->workspace_allocator->allocations, 0);
+}
+
+/**
+ * @brief Heap allocations a context's pools made since their counters were reset.
+ */
+static guint
+gst_sscma_yolov5_context_allocations (GstSscmaYolov5Context * ctx)
+{
+  return g_atomic_int_get (&ctx->blob_allocator->allocations)
+      + g_atomic_int_get (&ctx->workspace_allocator->allocations);
+}
+
+/**
+ * @brief Run the context's extractor on ctx->in, the results land in ctx->outs.
+ */
+static void
+gst_sscma_yolov5_context_run (GstSscmaYolov5Context * ctx)
+{
+  ctx->ex->clear ();
+  gst_sscma_yolov5_extract (ctx->model, ctx->ex, ctx->input_blob,
+      ctx->output_blobs, ctx->num_outs, ctx->in, ctx->outs);
+}
+
+/**
+ * @brief Decode ctx->outs into detections, with the decoder specialized for their shape.
+ */
+static void
+gst_sscma_yolov5_context_decode (GstSscmaYolov5Context * ctx,
+    GstSscmaYolov5Properties * prop, const GstSscmaInputTransform * transform,
+    guint width, guint height, GArray * results)
+{
+  GstSscmaDecodeParams params;
+
+  /* picked again only when the head, or the letterboxed input, changes
+   * shape, a shape no decoder fits is warned about once */
+  if (!ctx->decode_selected || ctx->outs[0].w != ctx->decode_channels
+      || ctx->outs[0].h != ctx->decode_anchors) {
+    ctx->decode = gst_sscma_decoder_select (ctx->decoder, ctx->outs,
+        ctx->num_outs);
+    ctx->decode_channels = ctx->outs[0].w;
+    ctx->decode_anchors = ctx->outs[0].h;
+    ctx->decode_selected = TRUE;
+    if (ctx->decode == NULL)
+      GST_WARNING_OBJECT (ctx->self, "Output blob %dx%d does not fit the "
+          "decoder", ctx->outs[0].w, ctx->outs[0].h);
+  }
+  if (ctx->decode == NULL)
+    return;
+
+  params.threshold = prop->threshold[0];
+  params.is_output_scaled = prop->is_output_scaled;
+  params.transform = transform;
+  params.width = width;
+  params.height = height;
+  params.anchors = ctx->anchors;
+  params.num_anchor_sets = ctx->num_anchor_sets;
+  params.max_score = ctx->max_score;
+  ctx->decode (ctx->outs, ctx->num_outs, &params, results);
+}
+
+/**
+ * @brief Pin the calling thread as the affinity properties ask, if they changed since it was last pinned.
+ *
+ * Threads keep the affinity they inherited until one of the properties is
+ * set. In sync mode the streaming thread runs the inference, so it follows
+ * cpu-mask unless streaming-cpu-mask is set.
+ * @param pinning affinity the thread was last pinned to
+ * @param streaming TRUE for the streaming thread, FALSE for an inference thread
+ */
+static void
+gst_sscma_yolov5_pin_thread (GstSscmaYolov5 * self,
+    GstSscmaYolov5Pinning * pinning, gboolean streaming)
+{
+  GThread *thread = g_thread_self ();
+  GstSscmaYolov5Powersave powersave = GST_SSCMA_YOLOV5_POWERSAVE_ALL;
+  gchar *mask;
+
+  g_mutex_lock (&self->queue_lock);
+  if (self->affinity_generation == 0
+      || (pinning->generation == self->affinity_generation
+          && pinning->thread == thread)) {
+    g_mutex_unlock (&self->queue_lock);
+    return;
+  }
+  pinning->generation = self->affinity_generation;
+  pinning->thread = thread;
+
+  if (streaming && self->running_async && self->streaming_cpu_mask == NULL) {
+    /* the streaming thread only queues frames, leave it where it is */
+    g_mutex_unlock (&self->queue_lock);
+    return;
+  }
+  if (streaming && self->streaming_cpu_mask)
+    mask = g_strdup (self->streaming_cpu_mask);
+  else {
+    mask = g_strdup (self->cpu_mask);
+    powersave = self->powersave;
+  }
+  g_mutex_unlock (&self->queue_lock);
+
+  if (!gst_sscma_set_thread_affinity (mask, powersave))
+    GST_WARNING_OBJECT (self, "Cannot set the CPU affinity of thread %p",
+        thread);
+  else
+    GST_DEBUG_OBJECT (self, "Pinned thread %p to %s", thread,
+        mask ? mask : "the powersave cores");
+  g_free (mask);
+}
+
+/**
+ * @brief Map a frame of the given size onto the model input, as the letterbox property asks.
+ */
+static void
+gst_sscma_yolov5_input_transform (GstSscmaYolov5Properties * prop, int width,
+    int height, GstSscmaInputTransform * transform)
+{
+  /* letterboxed inputs shrink to the frame's aspect ratio */
+  if (prop->letterbox)
+    gst_sscma_input_transform_letterbox (width, height,
+        MAX (prop->input_meta.info[0].dimension[1],
+            prop->input_meta.info[0].dimension[2]),
+        GST_SSCMA_LETTERBOX_ALIGN, transform);
+  else
+    gst_sscma_input_transform_stretch (width, height,
+        prop->input_meta.info[0].dimension[1],
+        prop->input_meta.info[0].dimension[2], transform);
+}
+
+/**
+ * @brief Infer one region of a frame on a context, boxes land in frame coordinates.
+ */
+static void
+gst_sscma_yolov5_infer_region (GstSscmaYolov5 * self,
+    GstSscmaYolov5Context * ctx, GstSscmaYolov5TileJob * job)
+{
+  GstSscmaYolov5Properties *prop = &self->prop;
+  GstSscmaInputTransform transform;
+  guint i;
+
+  g_array_set_size (job->results, 0);
+  gst_sscma_yolov5_context_sync_head (ctx);
+  gst_sscma_yolov5_context_bind (ctx, job->model, job->labels);
+  /* tile contexts serve every frame in flight, so count per region */
+  gst_sscma_yolov5_context_reset_allocations (ctx);
+
+  /* only the region's pixels are read */
+  gst_sscma_yolov5_input_transform (prop, job->tile.width, job->tile.height,
+      &transform);
+  gst_sscma_preprocess_roi_transform (job->image, &job->tile, &transform,
+      &job->resize, ctx->in, ctx->blob_allocator);
+  gst_sscma_yolov5_context_run (ctx);
+  job->allocations = gst_sscma_yolov5_context_allocations (ctx);
+  gst_sscma_yolov5_context_decode (ctx, prop, &transform, job->tile.width,
+      job->tile.height, job->results);
+  for (i = 0; i < job->results->len; i++) {
+    detectedObject *object = &g_array_index (job->results, detectedObject, i);
+    object->x += job->tile.x;
+    object->y += job->tile.y;
+  }
+}
+
+/**
+ * @brief Tile pool function: infer one tile on a free tile context.
+ */
+static void
+gst_sscma_yolov5_tile_run (gpointer data, gpointer user_data)
+{
+  GstSscmaYolov5TileJob *job = (GstSscmaYolov5TileJob *) data;
+  GstSscmaYolov5 *self = (GstSscmaYolov5 *) user_data;
+  GstSscmaYolov5Context *ctx =
+      (GstSscmaYolov5Context *) g_async_queue_pop (self->tile_free);
+
+  gst_sscma_yolov5_pin_thread (self, &ctx->pinning, FALSE);
+  gst_sscma_yolov5_infer_region (self, ctx, job);
+  g_async_queue_push (self->tile_free, ctx);
+
+  g_mutex_lock (&job->batch->lock);
+  if (--job->batch->pending == 0)
+    g_cond_signal (&job->batch->cond);
+  g_mutex_unlock (&job->batch->lock);
+}
+
+/**
+ * @brief Add the tiles of a region of the frame to regions.
+ * @return the new number of regions
+ */
+static guint
+gst_sscma_yolov5_add_tiles (const GstSscmaTile * region, guint tile_size,
+    gdouble overlap, guint max_tiles, gboolean global, GstSscmaTile * regions,
+    guint n)
+{
+  GstSscmaTile tiles[GST_SSCMA_MAX_TILES];
+  guint num_tiles, i;
+
+  num_tiles = gst_sscma_tile_layout (region->width, region->height, tile_size,
+      overlap, max_tiles, tiles);
+  for (i = 0; i < num_tiles && n < GST_SSCMA_MAX_TILES + 1; i++) {
+    regions[n] = tiles[i];
+    regions[n].x += region->x;
+    regions[n].y += region->y;
+    n++;
+  }
+  if (global && num_tiles > 1 && n < GST_SSCMA_MAX_TILES + 1)
+    regions[n++] = *region;
+
+  return n;
+}
+
+/**
+ * @brief List the regions of a width x height frame to infer on their own: the ROIs, their tiles.
+ * @param regions filled with up to GST_SSCMA_MAX_TILES + 1 regions
+ * @param[out] use_regions FALSE to infer the whole frame at once instead
+ * @return the number of regions, 0 if every ROI is outside the frame
+ */
+static guint
+gst_sscma_yolov5_layout_regions (GstSscmaYolov5 * self, int width, int height,
+    GstSscmaTile * regions, gboolean * use_regions)
+{
+  const GstSscmaTile frame = { 0, 0, width, height };
+  gboolean tiled;
+  guint n = 0, i;
+
+  g_mutex_lock (&self->queue_lock);
+  tiled = self->tile_pool != NULL && self->tile_size > 0;
+
+  for (i = 0; i < self->rois->len && n < GST_SSCMA_MAX_TILES + 1; i++) {
+    const GstSscmaTile *roi = &g_array_index (self->rois, GstSscmaTile, i);
+    GstSscmaTile region;
+
+    /* clip to the frame, a ROI may come from another resolution */
+    region.x = CLAMP (roi->x, 0, width);
+    region.y = CLAMP (roi->y, 0, height);
+    region.width = MIN (roi->x + roi->width, width) - region.x;
+    region.height = MIN (roi->y + roi->height, height) - region.y;
+    if (region.width <= 0 || region.height <= 0)
+      continue;
+
+    if (tiled)
+      n = gst_sscma_yolov5_add_tiles (&region, self->tile_size,
+          self->tile_overlap, self->max_tiles, self->tile_global, regions, n);
+    else
+      regions[n++] = region;
+  }
+
+  /* ROIs all outside the frame infer nothing, no ROI infers the whole frame */
+  if (self->rois->len == 0 && tiled)
+    n = gst_sscma_yolov5_add_tiles (&frame, self->tile_size,
+        self->tile_overlap, self->max_tiles, self->tile_global, regions, 0);
+  *use_regions = self->rois->len > 0 || tiled;
+  g_mutex_unlock (&self->queue_lock);
+
+  return n;
+}
+
+/**
+ * @brief Infer regions of a frame, on the tile pool when tiling is on.
+ *
+ * The heap allocations of every region are summed into self->allocations.
+ * @param results detections of every region in frame coordinates, before NMS
+ */
+static void
+gst_sscma_yolov5_infer_regions (GstSscmaYolov5 * self,
+    GstSscmaYolov5Context * ctx, const GstSscmaImage * image,
+    const GstSscmaTile * regions, guint n, GArray * results)
+{
+  GstSscmaYolov5TileBatch batch;
+  guint allocations = 0;
+  guint i;
+
+  if (ctx->tile_jobs == NULL) {
+    ctx->tile_jobs = g_new0 (GstSscmaYolov5TileJob, GST_SSCMA_MAX_TILES + 1);
+    for (i = 0; i <= GST_SSCMA_MAX_TILES; i++)
+      ctx->tile_jobs[i].results =
+          g_array_new (FALSE, TRUE, sizeof (detectedObject));
+  }
+
+  g_mutex_init (&batch.lock);
+  g_cond_init (&batch.cond);
+  batch.pending = n;
+  for (i = 0; i < n; i++) {
+    GstSscmaYolov5TileJob *job = &ctx->tile_jobs[i];
+
+    job->image = image;
+    job->tile = regions[i];
+    job->batch = &batch;
+    job->model = ctx->model;
+    job->labels = ctx->labels;
+    /* without tiling, the ROIs run one after the other on all threads */
+    if (self->tile_pool)
+      g_thread_pool_push (self->tile_pool, job, NULL);
+    else
+      gst_sscma_yolov5_infer_region (self, ctx, job);
+  }
+
+  if (self->tile_pool) {
+    g_mutex_lock (&batch.lock);
+    while (batch.pending > 0)
+      g_cond_wait (&batch.cond, &batch.lock);
+    g_mutex_unlock (&batch.lock);
+  }
+  g_mutex_clear (&batch.lock);
+  g_cond_clear (&batch.cond);
+
+  /* duplicates across tile seams go in the caller's single NMS pass */
+  g_array_set_size (results, 0);
+  for (i = 0; i < n; i++) {
+    g_array_append_vals (results, ctx->tile_jobs[i].results->data,
+        ctx->tile_jobs[i].results->len);
+    allocations += ctx->tile_jobs[i].allocations;
+  }
+  g_atomic_int_set (&self->allocations, allocations);
+}
+
+/**
+ * @brief Create the tile contexts and the pool running them, if tiling is on.
+ *
+ * Tiles are small inputs, so they run in parallel on single-threaded
+ * extractors, one per thread of the numthreads budget.
+ */
+static void
+gst_sscma_yolov5_start_tiles (GstSscmaYolov5 * self)
+{
+  GError *err = NULL;
+  guint i;
+
+  if (self->tile_size == 0)
+    return;
+
+  self->num_tile_contexts = MAX (1, self->prop.num_threads);
+  self->tile_contexts = new GstSscmaYolov5Context[self->num_tile_contexts] ();
+  self->tile_free = g_async_queue_new ();
+  for (i = 0; i < self->num_tile_contexts; i++) {
+    gst_sscma_yolov5_context_init (&self->tile_contexts[i], self, 1);
+    g_async_queue_push (self->tile_free, &self->tile_contexts[i]);
+  }
+
+  self->tile_pool = g_thread_pool_new (gst_sscma_yolov5_tile_run, self,
+      self->num_tile_contexts, TRUE, &err);
+  if (self->tile_pool == NULL) {
+    GST_WARNING_OBJECT (self, "Cannot create the tile threads, tiling is off: %s",
+        err->message);
+    g_clear_error (&err);
+  }
+}
+
+/**
+ * @brief Free the tile pool and contexts.
+ */
+static void
+gst_sscma_yolov5_stop_tiles (GstSscmaYolov5 * self)
+{
+  guint i;
+
+  if (self->tile_pool)
+    g_thread_pool_free (self->tile_pool, FALSE, TRUE);
+  self->tile_pool = NULL;
+  for (i = 0; i < self->num_tile_contexts; i++)
+    gst_sscma_yolov5_context_clear (&self->tile_contexts[i]);
+  delete[] self->tile_contexts;
+  self->tile_contexts = NULL;
+  self->num_tile_contexts = 0;
+  if (self->tile_free)
+    g_async_queue_unref (self->tile_free);
+  self->tile_free = NULL;
+}
+
+/**
+ * @brief Run warmup_runs inferences on a synthetic frame in every context.
+ *
+ * ncnn creates its layer workspaces and fills the allocator pools on the first
+ * runs, doing it here keeps that cost off the first real frames.
+ */
+static void
+gst_sscma_yolov5_warmup (GstSscmaYolov5 * self)
+{
+  GstSscmaYolov5Properties *prop = &self->prop;
+  const int w = prop->input_meta.info[0].dimension[1];
+  const int h = prop->input_meta.info[0].dimension[2];
+  gint64 start = g_get_monotonic_time ();
+  guint i, run;
+
+  for (i = 0; i < self->num_contexts + self->num_tile_contexts; i++) {
+    GstSscmaYolov5Context *ctx = i < self->num_contexts ? &self->contexts[i]
+        : &self->tile_contexts[i - self->num_contexts];
+
+    if (self->warmup_runs == 0 || !gst_sscma_yolov5_context_prepare (ctx))
+      break;
+    ctx->in.create (w, h, 3, (size_t) 4u, ctx->blob_allocator);
+    ctx->in.fill (0.5f);
+    for (run = 0; run < self->warmup_runs; run++)
+      gst_sscma_yolov5_context_run (ctx);
+  }
+
+  GST_OBJECT_LOCK (self);
+  self->warmup_time = (g_get_monotonic_time () - start) / 1000.0;
+  GST_OBJECT_UNLOCK (self);
+  GST_INFO_OBJECT (self, "%u warm-up runs on %u contexts took %.2f ms",
+      self->warmup_runs, self->num_contexts + self->num_tile_contexts,
+      self->warmup_time);
+}
+
+/**
+ * @brief Create the inference contexts, and the workers running them in async mode.
+ */
+static void
+gst_sscma_yolov5_start_worker (GstSscmaYolov5 * self)
+{
+  guint i;
+  int num_threads;
+
+  g_mutex_lock (&self->queue_lock);
+  self->worker_stop = FALSE;
+  self->flushing = FALSE;
+  self->busy = 0;
+  self->pop_seq = 0;
+  self->push_seq = 0;
+  self->schedule_ticket = 0;
+  self->schedule_turn = 0;
+  self->last_flow = GST_FLOW_OK;
+  self->dropped = 0;
+  self->reused = 0;
+  self->motion_skipped = 0;
+  gst_sscma_yolov5_reset_interval (self);
+  self->running_async = self->async;
+
+  /* split the thread budget so that K frames in flight do not oversubscribe */
+  self->num_contexts = self->async ? self->inflight : 1;
+  num_threads = MAX (1, self->prop.num_threads / (int) self->num_contexts);
+  self->contexts = new GstSscmaYolov5Context[self->num_contexts] ();
+  for (i = 0; i < self->num_contexts; i++)
+    gst_sscma_yolov5_context_init (&self->contexts[i], self, num_threads);
+  gst_sscma_yolov5_start_tiles (self);
+  g_mutex_unlock (&self->queue_lock);
+
+  /* nothing streams yet, so the contexts are still ours */
+  gst_sscma_yolov5_warmup (self);
+
+  g_mutex_lock (&self->queue_lock);
+  if (self->running_async) {
+    for (i = 0; i < self->num_contexts; i++) {
+      self->contexts[i].thread = g_thread_new ("sscma-infer",
+          gst_sscma_yolov5_worker, &self->contexts[i]);
+    }
+  }
+  g_mutex_unlock (&self->queue_lock);
+}
+
+/**
+ * @brief Stop the workers, discard frames they did not handle yet and free the contexts.
+ */
+static void
+gst_sscma_yolov5_stop_worker (GstSscmaYolov5 * self)
+{
+  guint i;
+
+  g_mutex_lock (&self->queue_lock);
+  self->worker_stop = TRUE;
+  self->flushing = TRUE;
+  g_cond_broadcast (&self->queue_cond);
+  g_mutex_unlock (&self->queue_lock);
+
+  for (i = 0; i < self->num_contexts; i++) {
+    if (self->contexts[i].thread)
+      g_thread_join (self->contexts[i].thread);
+  }
+  gst_sscma_yolov5_stop_tiles (self);
+
+  g_mutex_lock (&self->queue_lock);
+  self->running_async = FALSE;
+  for (i = 0; i < self->num_contexts; i++)
+    gst_sscma_yolov5_context_clear (&self->contexts[i]);
+  delete[] self->contexts;
+  self->contexts = NULL;
+  self->num_contexts = 0;
+  gst_sscma_yolov5_clear_queue (self);
+  g_mutex_unlock (&self->queue_lock);
+}
+
+/**
+ * @brief Inference thread: handles queued buffers and events.
+ *
+ * Items get a sequence number in the order they leave the FIFO queue, and
+ * each worker waits for its turn before pushing, so results go downstream in
+ * the same (PTS) order the frames arrived in while K frames are being
+ * inferred at once.
+ */
+static gpointer
+gst_sscma_yolov5_worker (gpointer data)
+{
+  GstSscmaYolov5Context *ctx = (GstSscmaYolov5Context *) data;
+  GstSscmaYolov5 *self = ctx->self;
+  GstMiniObject *item;
+  GstBuffer *outbuf;
+  GstFlowReturn ret;
+  guint64 seq;
+  gboolean infer, roi;
+
+  g_mutex_lock (&self->queue_lock);
+  while (TRUE) {
+    while (!self->worker_stop && g_queue_is_empty (&self->queue))
+      g_cond_wait (&self->queue_cond, &self->queue_lock);
+    if (self->worker_stop)
+      break;
+
+    item = (GstMiniObject *) g_queue_pop_head (&self->queue);
+    if (GST_IS_BUFFER (item))
+      self->queued_buffers--;
+    seq = self->pop_seq++;
+    /* counted before scheduling, which may drop the lock */
+    self->busy++;
+    /* before the next frame is taken, so that it sees the new ROIs */
+    roi = !GST_IS_BUFFER (item)
+        && gst_sscma_yolov5_roi_event (self, GST_EVENT_CAST (item), TRUE);
+    infer = GST_IS_BUFFER (item)
+        && gst_sscma_yolov5_schedule_inference (self, GST_BUFFER_CAST (item));
+    if (infer)
+      ctx->inference = self->scheduled_inference;
+    /* a frame reusing detections waits for the inferences taken before it */
+    while (GST_IS_BUFFER (item) && !infer && self->push_seq != seq)
+      g_cond_wait (&self->queue_cond, &self->queue_lock);
+    g_cond_broadcast (&self->queue_cond);
+    g_mutex_unlock (&self->queue_lock);
+
+    gst_sscma_yolov5_pin_thread (self, &ctx->pinning, FALSE);
+    ret = GST_FLOW_OK;
+    outbuf = NULL;
+    if (GST_IS_BUFFER (item))
+      ret = gst_sscma_yolov5_process (self, ctx, GST_BUFFER_CAST (item), infer,
+          &outbuf);
+
+    /* wait until every item taken before this one has been pushed */
+    g_mutex_lock (&self->queue_lock);
+    while (self->push_seq != seq)
+      g_cond_wait (&self->queue_cond, &self->queue_lock);
+    g_mutex_unlock (&self->queue_lock);
+
+    if (outbuf) {
+      ret = gst_pad_push (self->srcpad, outbuf);
+    } else if (roi) {
+      g_object_notify (G_OBJECT (self), "roi");
+      gst_event_unref (GST_EVENT_CAST (item));
+    } else if (!GST_IS_BUFFER (item)) {
+      gst_pad_push_event (self->srcpad, GST_EVENT_CAST (item));
     }
-    g_strfreev (str_thresholds);
+    if (ret == GST_FLOW_NOT_LINKED || ret < GST_FLOW_EOS)
+      GST_ELEMENT_FLOW_ERROR (self, ret);
+
+    g_mutex_lock (&self->queue_lock);
+    self->push_seq++;
+    self->busy--;
+    if (ret != GST_FLOW_OK)
+      self->last_flow = ret;
+    g_cond_broadcast (&self->queue_cond);
   }
-  return 0;
+  g_mutex_unlock (&self->queue_lock);
+
+  return NULL;
 }
 
-static void
-gst_sscma_yolov5_set_property (GObject * object, guint prop_id,
-    const GValue * value, GParamSpec * pspec)
+/**
+ * @brief Forward a sink event, in async mode serialized events are queued
+ * behind the frames that precede them.
+ */
+static gboolean
+gst_sscma_yolov5_queue_event (GstSscmaYolov5 * self, GstPad * pad,
+    GstObject * parent, GstEvent * event)
 {
-  GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (object);
-  GstSscmaYolov5Properties *prop;
-  gint status = 0;
-  // UNUSED (pspec);
+  g_mutex_lock (&self->queue_lock);
+  if (!self->running_async || !GST_EVENT_IS_SERIALIZED (event)) {
+    g_mutex_unlock (&self->queue_lock);
+    return gst_pad_event_default (pad, parent, event);
+  }
 
-  prop = &self->prop;
-  switch (prop_id) {
-    // input model :mode=xxx,xxx (can be multiple)
-    case PROP_MODEL:
-      status = _gtfc_setprop_MODEL (self, prop, value);
-      break;
-    // label file path :labels=xxx
-    case PROP_MODE_LABELS:
-      status = _gtfc_setprop_LABELS (self, prop, value);
-      break;
-    // Input video size: input=320:320:3
-    case PROP_INPUT:
-      status = _gtfc_setprop_DIMENSION (self, value, TRUE);
-      break;
-    // Model output size: output=85:6300:1:1 
-    case PROP_OUTPUT:
-      status = _gtfc_setprop_DIMENSION (self, value, FALSE);
-      break;
-    // TODO:input format: inputformat=RGB
-    case PROP_INPUTFORMAT:
-      // status = _gtfc_setprop_FORMAT (self, value);
-      break;
-    // Input type: inputtype=float32
-    case PROP_INPUTTYPE:
-      status = _gtfc_setprop_TYPE (self, value, TRUE);
-      break;
-    // Output type: outputtype=float32
-    case PROP_OUTPUTTYPE:
-      status = _gtfc_setprop_TYPE (self, value, FALSE);
-      break;
-    // Output result threshold and block diagram threshold: threshold=0.5:0.3
-    case PROP_THRESHOLD:
-      status = _gtfc_setprop_THRESHOLD (self, value);
-      break;
-    // Configuring thread count: numthreads=1
-    case PROP_NUMTHREADS:
-      status = 0;
-      if (g_value_get_int (value) > 0)
-        prop->num_threads = g_value_get_int (value);
-      else
-        status = -1;
-      break;
-    case PROP_IS_OUTPUT_SCALED:
-      self->prop.is_output_scaled = g_value_get_boolean (value);
-      break;
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
-      break;
+  if (self->flushing) {
+    g_mutex_unlock (&self->queue_lock);
+    gst_event_unref (event);
+    return FALSE;
   }
-  if(status != 0){
-    g_print ("Invalid param, please check your param.\n");
+
+  g_queue_push_tail (&self->queue, event);
+  g_cond_broadcast (&self->queue_cond);
+  g_mutex_unlock (&self->queue_lock);
+  return TRUE;
+}
+
+/**
+ * @brief TRUE if event is a custom sscma-roi event.
+ */
+static gboolean
+gst_sscma_yolov5_is_roi_event (GstEvent * event)
+{
+  const GstStructure *st = gst_event_get_structure (event);
+
+  return st != NULL && gst_structure_has_name (st, "sscma-roi");
+}
+
+/**
+ * @brief Apply a custom sscma-roi event.
+ *
+ * The event structure carries either a roi string, as the roi property takes,
+ * or the x, y, width and height ints of a single ROI. Neither clears the ROIs.
+ * The caller notifies "roi", without queue_lock held.
+ * @param locked TRUE if queue_lock is held
+ * @return TRUE if event was an sscma-roi event
+ */
+static gboolean
+gst_sscma_yolov5_roi_event (GstSscmaYolov5 * self, GstEvent * event,
+    gboolean locked)
+{
+  const GstStructure *st = gst_event_get_structure (event);
+  GArray *rois;
+  const gchar *roi;
+  gchar *str;
+  gint x, y, width, height;
+
+  if (!gst_sscma_yolov5_is_roi_event (event))
+    return FALSE;
+
+  roi = gst_structure_get_string (st, "roi");
+  if (roi == NULL && gst_structure_get_int (st, "x", &x)
+      && gst_structure_get_int (st, "y", &y)
+      && gst_structure_get_int (st, "width", &width)
+      && gst_structure_get_int (st, "height", &height))
+    str = g_strdup_printf ("%d:%d:%d:%d", x, y, width, height);
+  else
+    str = g_strdup (roi ? roi : "");
+
+  rois = g_array_new (FALSE, TRUE, sizeof (GstSscmaTile));
+  if (_gtfc_parse_ROI_checked (self, str, rois) == 0) {
+    if (!locked)
+      g_mutex_lock (&self->queue_lock);
+    _gtfc_set_ROI_locked (self, rois);
+    if (!locked)
+      g_mutex_unlock (&self->queue_lock);
   }
+  g_array_free (rois, TRUE);
+  g_free (str);
+
+  return TRUE;
 }
 
-static void
-gst_sscma_yolov5_get_property (GObject * object, guint prop_id,
-    GValue * value, GParamSpec * pspec)
+/**
+ * @brief This function handles src event, ROIs can be set from downstream.
+ */
+static gboolean
+gst_sscma_yolov5_src_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
 {
-  GstSscmaYolov5 *filter = GST_SWIFT_YOLOV5 (object);
+  GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (parent);
 
-  switch (prop_id) {
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CUSTOM_UPSTREAM:
+    case GST_EVENT_CUSTOM_BOTH:
+    case GST_EVENT_CUSTOM_BOTH_OOB:
+      if (gst_sscma_yolov5_roi_event (self, event, FALSE)) {
+        g_object_notify (G_OBJECT (self), "roi");
+        gst_event_unref (event);
+        return TRUE;
+      }
+      break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+
+  return gst_pad_event_default (pad, parent, event);
 }
 
 /**
@@ -617,21 +3347,44 @@ gst_sscma_yolov5_sink_event (GstPad * pad, GstObject * parent,
       GST_EVENT_TYPE_NAME (event), event);
 
   switch (GST_EVENT_TYPE (event)) {
-    case GST_EVENT_STREAM_START:
+    case GST_EVENT_FLUSH_START:
     {
-      // load model
-      if (self->prop.num_models > 0) {
-        net.load_param(self->prop.model_files[1]);
-        net.load_model(self->prop.model_files[0]);
-      }
+      /* discard in-flight frames, the worker's current push fails with FLUSHING */
+      g_mutex_lock (&self->queue_lock);
+      self->flushing = TRUE;
+      gst_sscma_yolov5_clear_queue (self);
+      g_cond_broadcast (&self->queue_cond);
+      g_mutex_unlock (&self->queue_lock);
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+    }
+    case GST_EVENT_FLUSH_STOP:
+    {
+      g_mutex_lock (&self->queue_lock);
+      while (self->busy > 0)
+        g_cond_wait (&self->queue_cond, &self->queue_lock);
+      gst_sscma_yolov5_clear_queue (self);
+      gst_sscma_yolov5_reset_interval (self);
+      self->flushing = FALSE;
+      self->last_flow = GST_FLOW_OK;
+      g_mutex_unlock (&self->queue_lock);
       ret = gst_pad_event_default (pad, parent, event);
       break;
     }
     case GST_EVENT_CAPS:
     {
       GstCaps *in_caps;
+      GstVideoInfo old_vinfo;
+      /* frames already queued were negotiated with the previous caps */
+      gst_sscma_yolov5_drain (self);
       gst_event_parse_caps (event, &in_caps);
+      old_vinfo = self->vinfo;
       if (gst_sscma_yolov5_parse_caps (self, in_caps)) {
+        /* the last results are in the coordinates of the previous frames */
+        g_mutex_lock (&self->queue_lock);
+        if (!gst_video_info_is_equal (&old_vinfo, &self->vinfo))
+          gst_sscma_yolov5_reset_interval (self);
+        g_mutex_unlock (&self->queue_lock);
         ret = gst_sscma_yolov5_update_caps (self, in_caps);
         gst_event_unref (event);
       } else {
@@ -640,8 +3393,30 @@ gst_sscma_yolov5_sink_event (GstPad * pad, GstObject * parent,
       }
       break;
     }
+    case GST_EVENT_CUSTOM_DOWNSTREAM:
+    case GST_EVENT_CUSTOM_DOWNSTREAM_OOB:
+    case GST_EVENT_CUSTOM_BOTH:
+    case GST_EVENT_CUSTOM_BOTH_OOB:
+      /* in async mode serialized ROIs wait in the queue behind the frames
+       * before them, the worker taking them applies them */
+      if (gst_sscma_yolov5_is_roi_event (event)) {
+        g_mutex_lock (&self->queue_lock);
+        if (self->running_async && GST_EVENT_IS_SERIALIZED (event)) {
+          g_mutex_unlock (&self->queue_lock);
+          ret = gst_sscma_yolov5_queue_event (self, pad, parent, event);
+          break;
+        }
+        g_mutex_unlock (&self->queue_lock);
+        gst_sscma_yolov5_roi_event (self, event, FALSE);
+        g_object_notify (G_OBJECT (self), "roi");
+        gst_event_unref (event);
+        ret = TRUE;
+        break;
+      }
+      ret = gst_sscma_yolov5_queue_event (self, pad, parent, event);
+      break;
     default:
-      ret = gst_pad_event_default (pad, parent, event);
+      ret = gst_sscma_yolov5_queue_event (self, pad, parent, event);
       break;
   }
 
@@ -693,6 +3468,32 @@ gst_sscma_yolov5_sink_query (GstPad * pad, GstObject * parent,
         gst_caps_unref (template_caps);
       }
       gst_query_set_accept_caps_result (query, res);
+      ret = TRUE;
+      break;
+    }
+    case GST_QUERY_DRAIN:
+      gst_sscma_yolov5_drain (self);
+      ret = gst_pad_query_default (pad, parent, query);
+      break;
+    case GST_QUERY_ALLOCATION:
+    {
+      GstCaps *sink_caps = gst_pad_get_current_caps (self->sinkpad);
+      GstCaps *src_caps = gst_pad_get_current_caps (self->srcpad);
+
+      /* video out: the frames go downstream, let it pick the pool */
+      if (sink_caps && src_caps && gst_caps_is_equal (sink_caps, src_caps))
+        ret = gst_pad_peer_query (self->srcpad, query);
+      else
+        ret = gst_sscma_propose_allocation (pad, parent, query);
+      if (sink_caps)
+        gst_caps_unref (sink_caps);
+      if (src_caps)
+        gst_caps_unref (src_caps);
+
+      /* frames are mapped with their video meta, padded strides are fine */
+      if (ret && !gst_query_find_allocation_meta (query,
+              GST_VIDEO_META_API_TYPE, NULL))
+        gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
       break;
     }
     default:
@@ -749,183 +3550,208 @@ gst_swift_yolov5_validate (GstSscmaYolov5Properties * prop,
 }
 
 /**
- * @brief Chain function, this function does the actual processing.
+ * @brief Chain function, runs the inference inline or hands the frame to the worker.
  */
 static GstFlowReturn
 gst_sscma_yolov5_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
 {
   GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (parent);
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBuffer *outbuf = NULL;
+  UNUSED (pad);
+
+  gst_sscma_yolov5_pin_thread (self, &self->streaming_pinning, TRUE);
+
+  g_mutex_lock (&self->queue_lock);
+  /* stopped or flushing, not an error: the pad is being deactivated */
+  if (self->flushing || self->contexts == NULL) {
+    g_mutex_unlock (&self->queue_lock);
+    gst_buffer_unref (buf);
+    return GST_FLOW_FLUSHING;
+  }
+
+  if (!self->running_async) {
+    gboolean infer = gst_sscma_yolov5_schedule_inference (self, buf);
+    guint64 inference = self->scheduled_inference;
+    g_mutex_unlock (&self->queue_lock);
+    self->contexts[0].inference = inference;
+    ret = gst_sscma_yolov5_process (self, &self->contexts[0], buf, infer,
+        &outbuf);
+    if (ret != GST_FLOW_OK)
+      return ret;
+    return gst_pad_push (self->srcpad, outbuf);
+  }
+
+  while (!self->flushing && self->last_flow == GST_FLOW_OK
+      && self->queued_buffers >= self->max_queue_size) {
+    if (self->drop_policy == GST_SSCMA_YOLOV5_DROP_BLOCK) {
+      g_cond_wait (&self->queue_cond, &self->queue_lock);
+    } else if (self->drop_policy == GST_SSCMA_YOLOV5_DROP_NEWEST) {
+      GST_LOG_OBJECT (self, "Queue full, dropping frame %" GST_PTR_FORMAT, buf);
+      self->dropped++;
+      g_mutex_unlock (&self->queue_lock);
+      gst_buffer_unref (buf);
+      return GST_FLOW_OK;
+    } else {
+      gst_sscma_yolov5_drop_oldest (self);
+    }
+  }
+
+  if (self->flushing)
+    ret = GST_FLOW_FLUSHING;
+  else
+    ret = self->last_flow;
+
+  if (ret != GST_FLOW_OK) {
+    g_mutex_unlock (&self->queue_lock);
+    gst_buffer_unref (buf);
+    return ret;
+  }
+
+  g_queue_push_tail (&self->queue, buf);
+  self->queued_buffers++;
+  g_cond_broadcast (&self->queue_cond);
+  g_mutex_unlock (&self->queue_lock);
+
+  return GST_FLOW_OK;
+}
+
+/**
+ * @brief Process one frame: preprocess, inference, decode, then draw or convert to json.
+ * @param ctx the inference context of the calling thread
+ * @param buf the input frame, always consumed
+ * @param infer FALSE to skip the inference and reuse the last detections
+ * @param[out] outbuf the buffer to push on success
+ */
+static GstFlowReturn
+gst_sscma_yolov5_process (GstSscmaYolov5 * self, GstSscmaYolov5Context * ctx,
+    GstBuffer * buf, gboolean infer, GstBuffer ** outbuf)
+{
   GstSscmaYolov5Properties *prop = &self->prop;
-  GstBuffer *inbuf;
-  GstMapInfo src_info, dest_info;
-  GstTensorsInfo *info;
-  GstTensorInfo *_info;
-  gsize buf_size, frame_size, out_size, type;
+  GstVideoFrame frame;
+  GstSscmaImage image;
+  gsize buf_size;
   guint32 timestamp, temp_time;
-  guint color, width, height, max_index, cIdx_max;
-  gfloat *data, max_index_val;
-  GArray *results = NULL, *infer_time = NULL;
-  // UNUSED (pad);
-
-  ncnn::Mat in_pad;
-  ncnn::Mat out;
-  ncnn::Extractor ex = net.create_extractor();
+  guint width, height;
+  GstSscmaInputTransform transform;
+  GArray *results = ctx->results, *infer_time = ctx->infer_time;
+  GstSscmaTile regions[GST_SSCMA_MAX_TILES + 1];
+  guint num_regions;
+  gboolean use_regions;
 
   /* 0. validate input */
   buf_size = gst_buffer_get_size (buf);
   g_return_val_if_fail (buf_size > 0, GST_FLOW_ERROR);
 
+  if (!gst_sscma_yolov5_context_prepare (ctx)) {
+    GST_ELEMENT_ERROR (self, CORE, NEGOTIATION,
+        ("No model loaded, please set the model property."), (NULL));
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+
   /* 1. Check all properties. */
   GstFlowReturn retval = gst_swift_yolov5_validate (prop, buf);
   if (retval != GST_FLOW_OK)
     return retval;
 
   /* 2. preprocess data */
-  // g_assert (self->tensors_configured);
-  info = &self->input_info;
-  color = info->info[0].dimension[0];
-  width = info->info[0].dimension[1];
-  height = info->info[0].dimension[2];
-  type = tensor_element_size[info->info[0].type];
-  /** type * colorspace * width * height */
-  frame_size = type * color * width * height;
-  /** supposed 1 frame in buffer */
-  g_assert ((buf_size / frame_size) == 1);
-
-  if (!gst_buffer_map (buf, &src_info, GST_MAP_READ | GST_MAP_WRITE)) {
-    g_print
-        ("tensor_converter: Cannot map src buffer at tensor_converter/video. The incoming buffer (GstBuffer) for the sinkpad of tensor_converter cannot be mapped for reading.\n");
+  width = GST_VIDEO_INFO_WIDTH (&self->vinfo);
+  height = GST_VIDEO_INFO_HEIGHT (&self->vinfo);
+  /* honors the strides and plane offsets of a GstVideoMeta, if any */
+  if (!gst_video_frame_map (&frame, &self->vinfo, buf,
+          (GstMapFlags) (GST_MAP_READ | GST_MAP_WRITE))) {
+    GST_ELEMENT_ERROR (self, STREAM, FORMAT,
+        ("Cannot map a frame of %" G_GSIZE_FORMAT " bytes as %s %dx%d",
+            buf_size, GST_VIDEO_INFO_NAME (&self->vinfo), width, height),
+        (NULL));
     goto error;
   }
-  /* output size*/
-  out_size = tensor_element_size[prop->output_meta.info[0].type];
-  for(int i = 0; i <3; i++){
-    out_size *= prop->output_meta.info[0].dimension[i];
+  gst_sscma_image_from_video_frame (&image, &frame);
+  if (!infer) {
+    /* reuse the last detections, they are already in frame coordinates */
+    gst_sscma_yolov5_load_results (self, results);
+    g_array_set_size (infer_time, 3);
+    memset (infer_time->data, 0, 3 * sizeof (guint32));
+    goto output;
   }
 
-  inbuf = gst_buffer_new_and_alloc (out_size);
-  gst_buffer_memset (inbuf, 0, 0, out_size);
-  if (!gst_buffer_map (inbuf, &dest_info, GST_MAP_WRITE)) {
-    g_print
-        ("tensor_converter: Cannot map dest buffer at tensor_converter/video. The outgoing buffer (GstBuffer) for the srcpad of tensor_converter cannot be mapped for writing.\n");
-    gst_buffer_unmap (buf, &src_info);
-    goto error;
+  num_regions = gst_sscma_yolov5_layout_regions (self, width, height, regions,
+      &use_regions);
+  if (use_regions) {
+    /* ROIs and tiles are preprocessed and inferred one region at a time */
+    timestamp = (guint32) (g_get_monotonic_time () / 1000);
+    g_array_set_size (infer_time, 1);
+    g_array_index (infer_time, guint32, 0) = 0;
+    gst_sscma_yolov5_infer_regions (self, ctx, &image, regions, num_regions,
+        results);
+    temp_time = (guint32) (g_get_monotonic_time () / 1000) - timestamp;
+    g_array_append_val (infer_time, temp_time);
+    timestamp += temp_time;
+    goto nms;
   }
 
+  /* input geometry */
+  gst_sscma_yolov5_input_transform (prop, width, height, &transform);
+
   /* 3. inference*/
   timestamp = (guint32) (g_get_monotonic_time () / 1000);
-  infer_time = g_array_sized_new (FALSE, TRUE, sizeof (guint32), 1);
+  g_array_set_size (infer_time, 0);
+  gst_sscma_yolov5_context_reset_allocations (ctx);
   for (uint i = 0; i < self->input_info.num_tensors; ++i) {
-    _info = gst_tensors_info_get_nth_info (info, i);
-    in_pad = ncnn::Mat::from_pixels_resize(src_info.data, ncnn::Mat::PIXEL_RGB, width, height, prop->input_meta.info[i].dimension[1], prop->input_meta.info[i].dimension[2]);
+    gst_sscma_preprocess_transform (&image, &transform, &ctx->resize,
+        ctx->in, ctx->blob_allocator);
     temp_time = timestamp;
     timestamp = (guint32) (g_get_monotonic_time () / 1000);
     temp_time = timestamp - temp_time;
     g_array_append_val (infer_time, temp_time);
-    const float norm_vals[3] = {1 / 255.f, 1 / 255.f, 1 / 255.f};
-    ex.set_num_threads(prop->num_threads);
-    in_pad.substract_mean_normalize(0, norm_vals);
-    ex.input("in0", in_pad);
-    ex.extract("out0", out);
-    g_assert (out.total() * out.elemsize == out_size);
-    memcpy (dest_info.data, out.data, out_size);
+    gst_sscma_yolov5_context_run (ctx);
     temp_time = timestamp;
     timestamp = (guint32) (g_get_monotonic_time () / 1000);
     temp_time = timestamp - temp_time;
     g_array_append_val (infer_time, temp_time);
   }
+  g_atomic_int_set (&self->allocations,
+      gst_sscma_yolov5_context_allocations (ctx));
 
-  /* 4. Post-processing of the data*/
-  cIdx_max = prop->total_labels + DETECTION_NUM_INFO;
-  results = g_array_sized_new (FALSE, TRUE, sizeof (detectedObject), prop->output_meta.info[0].dimension[2]);
-  data = (float *)dest_info.data;
-  for (int delect_num = 0; delect_num < prop->output_meta.info[0].dimension[1]; delect_num++) {
-    max_index_val = 0;
-    max_index = 0;
-    // Find the class with the maximum confidence
-    for (int i = DETECTION_NUM_INFO; i < prop->total_labels; ++i) {
-      if (data[delect_num * cIdx_max + i] > max_index_val) {
-        max_index_val = data[delect_num * cIdx_max + i];
-        max_index = i;
-      }
-    }
-
-    // If the maximum confidence is greater than the threshold, then the result is valid
-    if (max_index_val * data[delect_num * cIdx_max + 4] > prop->threshold[0]) {
-      detectedObject object;
-      float cx, cy, w, h;
-      cx = data[delect_num * cIdx_max + 0];
-      cy = data[delect_num * cIdx_max + 1];
-      w = data[delect_num * cIdx_max + 2];
-      h = data[delect_num * cIdx_max + 3];
-
-      // If the output is scaled, then the coordinates need to be scaled
-      if (!prop->is_output_scaled) {
-        cx *= (float) width;
-        cy *= (float) height;
-        w *= (float) width;
-        h *= (float) height;
-      }
-
-      object.x = (int) (MAX (0.f, (cx - w / 2.f))) * width / prop->input_meta.info[0].dimension[1];
-      object.y = (int) (MAX (0.f, (cy - h / 2.f))) * height / prop->input_meta.info[0].dimension[2];
-      object.width = (int) (MIN ((float) width, w)) * width / prop->input_meta.info[0].dimension[1];
-      object.height = (int) (MIN ((float) height, h)) * height / prop->input_meta.info[0].dimension[2];
+  /* 4. Post-processing of the data, straight from the output blob */
+  g_array_set_size (results, 0);
+  gst_sscma_yolov5_context_decode (ctx, prop, &transform, width, height,
+      results);
 
-      object.prob = max_index_val * data[delect_num * cIdx_max + 4];
-      object.class_id = max_index - DETECTION_NUM_INFO;
-      object.tracking_id = int(max_index_val);
-      object.valid = TRUE;
-      g_array_append_val (results, object);
-    }
-  }
+nms:
+  gst_sscma_nms (results, prop->threshold[1]);
   temp_time = (guint32) (g_get_monotonic_time () / 1000) - timestamp;
   g_array_append_val (infer_time, temp_time);
-  /* clear inbuf */
-  gst_buffer_unmap (inbuf, &dest_info);
-  gst_buffer_unref (inbuf);
-  nms (results, prop->threshold[1]);
+  gst_sscma_yolov5_store_results (self, ctx->inference, results);
 
+output:
   /* 5. draw box or convert json */
   GstCaps *sink_caps, *src_caps;
   sink_caps = gst_pad_get_current_caps (self->sinkpad);
   src_caps = gst_pad_get_current_caps (self->srcpad);
   if(gst_caps_is_equal(sink_caps, src_caps)) {
-    // TODO：支持多个输出格式 主要是RGB RGBA
-    draw (&src_info, self, results);
-    g_array_free (results, TRUE);
-    
-    gst_buffer_unmap (buf, &src_info);
-    return gst_pad_push (self->srcpad, buf);
+    gst_caps_unref (sink_caps);
+    gst_caps_unref (src_caps);
+    gst_sscma_draw (&image, ctx->labels ? ctx->labels->names : NULL,
+        ctx->labels ? ctx->labels->count : 0, results);
+
+    gst_video_frame_unmap (&frame);
+    *outbuf = buf;
+    return GST_FLOW_OK;
   }
   else{
-    GstBuffer *outbuf;
-    gchar *outbuf_data;
-    guint outbuf_size;
-
-    outbuf_size = convert_json (&outbuf_data, src_info, results, infer_time);
-    outbuf = gst_buffer_new_and_alloc (outbuf_size);
-    gst_buffer_map (outbuf, &dest_info, GST_MAP_WRITE);
-    if (outbuf_size)
-      memcpy (&dest_info.data[0], outbuf_data, outbuf_size);
-
-    /* clear inbuf */
-    g_array_free (results, TRUE);
-    g_array_free (infer_time, TRUE);
-    g_free (outbuf_data);
-
-    gst_buffer_copy_into (outbuf, buf,
-      GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS |
-      GST_BUFFER_COPY_METADATA, 0, -1);
-
-    gst_buffer_unmap (buf, &src_info);
+    if (sink_caps)
+      gst_caps_unref (sink_caps);
+    if (src_caps)
+      gst_caps_unref (src_caps);
+
+    *outbuf = gst_sscma_json_buffer (buf, &frame.map[0], results, infer_time);
+    gst_video_frame_unmap (&frame);
     gst_buffer_unref (buf);
-    gst_buffer_unmap (outbuf, &dest_info);
-    return gst_pad_push (self->srcpad, outbuf);
+    return GST_FLOW_OK;
   }
 error:
-  if (inbuf)
-    gst_buffer_unref (inbuf);
   gst_buffer_unref (buf);
   return GST_FLOW_ERROR;
 }
@@ -1005,9 +3831,19 @@ gst_sscma_yolov5_parse_video (GstSscmaYolov5 * self,
       info->info[0].type = _TENOR_UINT8;
       info->info[0].dimension[0] = 4;
       break;
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_I420:
+      /* planar, the tensor describes the luma plane */
+      info->info[0].type = _TENOR_UINT8;
+      info->info[0].dimension[0] = 1;
+      break;
+    case GST_VIDEO_FORMAT_YUY2:
+      info->info[0].type = _TENOR_UINT8;
+      info->info[0].dimension[0] = 2;
+      break;
     default:
       GST_WARNING_OBJECT (self,
-          "The given video caps with format \"%s\" is not supported. Please use GRAY8, GRAY16_LE, GRAY16_BE, RGB, BGR, RGBx, BGRx, xRGB, xBGR, RGBA, BGRA, ARGB, or ABGR.\n",
+          "The given video caps with format \"%s\" is not supported. Please use RGB, BGR, RGBx, BGRx, RGBA, BGRA, NV12, I420 or YUY2.\n",
           GST_STR_NULL (gst_video_format_to_string (format)));
       break;
   }
@@ -1022,27 +3858,7 @@ gst_sscma_yolov5_parse_video (GstSscmaYolov5 * self,
 
   self->rate_n = GST_VIDEO_INFO_FPS_N (&vinfo);
   self->rate_d = GST_VIDEO_INFO_FPS_D (&vinfo);
-
-  /**
-   * @todo The actual list is much longer, fill them.
-   * (read https://gstreamer.freedesktop.org/documentation/design/mediatype-video-raw.html)
-   */
-  switch (format) {
-    case GST_VIDEO_FORMAT_GRAY8:
-    case GST_VIDEO_FORMAT_RGB:
-    case GST_VIDEO_FORMAT_BGR:
-    case GST_VIDEO_FORMAT_I420:
-      if (width % 4) {
-        GST_ERROR_OBJECT (self,
-          "\nYOUR STREAM INFOURATION INCURS PERFORMANCE DETERIORATION!\n"
-          "Please use 4 x n as image width for inputs; the width of your input is %d.\n",
-          width);
-        return NULL;
-      }
-      break;
-    default:
-      break;
-  }
+  self->vinfo = vinfo;
 
   return (info->info[0].type != _TENOR_END);
 }
@@ -1152,242 +3968,41 @@ gst_sscma_yolov5_update_caps (GstSscmaYolov5 * self, GstCaps * in_caps)
 }
 
 /**
- * @brief Compare Function for g_array_sort with detectedObject.
- */
-static gint
-compare_detection (gconstpointer _a, gconstpointer _b)
-{
-  const detectedObject *a = _a;
-  const detectedObject *b = _b;
-
-  /* Larger comes first */
-  return (a->prob > b->prob) ? -1 : ((a->prob == b->prob) ? 0 : 1);
-}
-
-/**
- * @brief Calculate the intersected surface
- */
-static gfloat
-iou (detectedObject * a, detectedObject * b)
-{
-  int x1 = MAX (a->x, b->x);
-  int y1 = MAX (a->y, b->y);
-  int x2 = MIN (a->x + a->width, b->x + b->width);
-  int y2 = MIN (a->y + a->height, b->y + b->height);
-  int w = MAX (0, (x2 - x1 + 1));
-  int h = MAX (0, (y2 - y1 + 1));
-  float inter = w * h;
-  float areaA = a->width * a->height;
-  float areaB = b->width * b->height;
-  float o = inter / (areaA + areaB - inter);
-  return (o >= 0) ? o : 0;
-}
-
-/**
- * @brief Apply NMS to the given results (objects[MOBILENET_SSD_DETECTION_MAX])
- * @param[in/out] results The results to be filtered with nms
- */
-static void
-nms (GArray * results, gfloat threshold)
-{
-  guint boxes_size;
-  guint i, j;
-
-  boxes_size = results->len;
-  if (boxes_size == 0U)
-    return;
-
-  g_array_sort (results, compare_detection);
-
-  for (i = 0; i < boxes_size; i++) {
-    detectedObject *a = &g_array_index (results, detectedObject, i);
-    if (a->valid == TRUE) {
-      for (j = i + 1; j < boxes_size; j++) {
-        detectedObject *b = &g_array_index (results, detectedObject, j);
-        if (b->valid == TRUE) {
-          if (iou (a, b) > threshold) {
-            b->valid = FALSE;
-          }
-        }
-      }
-    }
-  }
-
-  i = 0;
-  do {
-    detectedObject *a = &g_array_index (results, detectedObject, i);
-    if (a->valid == FALSE)
-      g_array_remove_index (results, i);
-    else
-      i++;
-  } while (i < results->len);
-
-}
-
-/**
- * @brief Draw with the given results (objects[MOBILENET_SSD_DETECTION_MAX]) to the output buffer
- * @param[out] out_info The output buffer (RGB plain)
- * @param[in] results The final results to be drawn.
+ * @brief Load the model and start the inference contexts with the streaming state.
+ *
+ * The model stays loaded across PAUSED to READY, so restarting a stream (e.g.
+ * a reconnecting RTSP source) finds it in the cache instead of reloading it.
  */
-static void
-draw (GstMapInfo * out_info, GstSscmaYolov5 *self, GArray * results)
+static GstStateChangeReturn
+gst_sscma_yolov5_change_state (GstElement * element, GstStateChange transition)
 {
-  GstSscmaYolov5Properties *prop = &self->prop;
-  uint8_t *frame = (uint8_t *) out_info->data;        /* Let's draw per pixel (4bytes) */
-  unsigned int i;
-  guint color = self->input_info.info[0].dimension[0];
-  guint width = self->input_info.info[0].dimension[1];
-  guint height = self->input_info.info[0].dimension[2];
-  
-  for (i = 0; i < results->len; i++) {
-    int x1, x2, y1, y2;         /* Box positions on the output surface */
-    int j;
-    uint8_t *pos1, *pos2;
-    detectedObject *a = &g_array_index (results, detectedObject, i);
-
-    if ((a->class_id < 0 ||
-                a->class_id >= (int) prop->total_labels)) {
-      /** @todo make it "logw_once" after we get logw_once API. */
-      g_print ("Invalid class found with tensordec-boundingbox.c.\n");
-      continue;
-    }
-
-    /* 1. Draw Boxes */
-    x1 =  a->x;
-    x2 = MIN (width - 1, (a->x + a->width));
-    y1 = a->y ;
-    y2 = MIN (height - 1,(a->y + a->height));
-    /* 1-1. Horizontal */
-    pos1 = &frame[(y1 * width + x1) * 3];
-    pos2 = &frame[(y2 * width + x1) * 3];
-    for (j = x1; j <= x2; j++) {
-      *pos1 = PIXEL_VALUE;
-      *pos2 = PIXEL_VALUE;
-      pos1 += 3;
-      pos2 += 3;
-    }
-
-    /* 1-2. Vertical */
-    pos1 = &frame[((y1 + 1) * width + x1) * 3];
-    pos2 = &frame[((y1 + 1) * width + x2) * 3];
-    for (j = y1 + 1; j < y2; j++) {
-      *pos1 = PIXEL_VALUE;
-      *pos2 = PIXEL_VALUE;
-      pos1 += width * 3;
-      pos2 += width * 3;
-    }
-
-    /* 2. Write Labels + tracking ID */
-    g_autofree gchar *label = NULL;
-    gsize label_len;
-    label = g_strdup_printf ("%s %d", prop->labels[a->class_id],
-            a->tracking_id);
-    label_len = strlen (label);
-    /* x1 is the same: x1 = MAX (0, (width * a->x) / bdata->i_width); */
-    y1 = MAX (0, (y1 - 14));
-    pos1 = &frame[(y1 * width + x1) * 3];
-    for (guint j = 0; j < label_len; j++) {
-      unsigned int char_index = label[j];
-      if (char_index < 32 || char_index >= 127) {
-        /* It's not ASCII */
-        char_index = '*';
-      }
-      char_index -= 32;
-      if ((x1 + 8 * 3) > (int) width)
-        break;                /* Stop drawing if it may overfill */
-      pos2 = pos1;
-      for (y2 = 0; y2 < 13; y2++) {
-        /* 13 : character height */
-        for (x2 = 0; x2 < 8; x2++) {
-          /* 8: character width */
-          *(pos2 + x2 * 3) = rasters[char_index][13-y2] & (1 << (7 - x2)) ?
-              PIXEL_VALUE : *(pos2 + x2 * 3);
-        }
-        pos2 += width * 3;
-      }
-      x1 += 9 * 3;
-      pos1 += 9 * 3;              /* charater width + 1px */
-    }
+  GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (!gst_sscma_yolov5_load_model (self))
+        return GST_STATE_CHANGE_FAILURE;
+      gst_sscma_yolov5_start_worker (self);
+      break;
+    default:
+      break;
   }
-}
-
-/**
- * @brief Convert the given results (objects[MOBILENET_SSD_DETECTION_MAX]) to json format
- * @param[in] outbuf The output buffer (json format)
- * @param[in] imgdata The input buffer (RGB plain)
- * @param[in] results The final results to be converted.
- * @return The size of json format
- * 
- * outbuf json format:
- * {
- *  "type": 1,
- *  "name": "INVOKE",
- *  "code": 0,
- *  "data": {
- *    "count": 8,
- *    "perf": [8, 365, 0],
- *    "boxes": [[87,83,77,65,70,0],[...]]
-*    "image": "<BASE64JPEG:String>"
- *  }
- * }
- */
-static guint
-convert_json (char ** outbuf, GstMapInfo imgdata, GArray * results, GArray * infer_time)
-{
-
-  JsonObject *json;
-  JsonNode *root;
-  JsonGenerator *generator;
-
-  /* create json */
-  json = json_object_new ();
-  json_object_set_int_member (json, "type", 1);
-  json_object_set_string_member (json, "name", "INVOKE");
-  json_object_set_int_member (json, "code", 0);
-
-  JsonObject *data = json_object_new ();
-  json_object_set_int_member (data, "count", results->len);
 
-  JsonArray *perf = json_array_new ();
-  for (guint i = 0; i < infer_time->len; i++) {
-    json_array_add_int_element (perf, g_array_index (infer_time, guint, i));
-  }
-  json_object_set_array_member (data, "perf", perf);
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
 
-  JsonArray *boxes = json_array_new ();
-  for (guint i = 0; i < results->len; i++) {
-    detectedObject *a = &g_array_index (results, detectedObject, i);
-    JsonArray *box = json_array_new ();
-    json_array_add_int_element (box, a->x);
-    json_array_add_int_element (box, a->y);
-    json_array_add_int_element (box, a->width);
-    json_array_add_int_element (box, a->height);
-    json_array_add_int_element (box, a->tracking_id);
-    json_array_add_int_element (box, a->class_id);
-    json_array_add_array_element (boxes, box);
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* the pads are deactivated, so the streaming thread has left the chain
+       * and downstream is in READY: the worker cannot block in a push */
+      gst_sscma_yolov5_stop_worker (self);
+      gst_sscma_yolov5_stop_reload (self);
+      break;
+    default:
+      break;
   }
-  json_object_set_array_member (data, "boxes", boxes);
 
-  /* imgdata to base64 */
-  g_autofree gchar *base64 = NULL;
-  gsize base64_len;
-  base64 = g_base64_encode (imgdata.data, imgdata.size);
-  base64_len = strlen (base64);
-  json_object_set_string_member (data, "image", base64);
-
-  json_object_set_object_member (json, "data", data);
-
-  /* convert JSON to string */
-  /* Make it the root node */
-  root = json_node_init_object (json_node_alloc (), json);
-  generator = json_generator_new ();
-  json_generator_set_indent (generator, 2);
-  json_generator_set_indent_char (generator, ' ');
-  json_generator_set_pretty (generator, TRUE);
-  json_generator_set_root (generator, root);
-  *outbuf = json_generator_to_data (generator, NULL);
-
-  return strlen (*outbuf);
+  return ret;
 }
 
 /* entry point to initialize the plug-in
@@ -1404,7 +4019,8 @@ sscma_yolov5_init (GstPlugin * sscmayolov5)
   GST_DEBUG_CATEGORY_INIT (gst_sscma_yolov5_debug, "sscmayolov5",
       0, "Template sscma yolov5");
 
-  return GST_ELEMENT_REGISTER (sscma_yolov5, sscmayolov5);
+  return GST_ELEMENT_REGISTER (sscma_yolov5, sscmayolov5)
+      && GST_ELEMENT_REGISTER (sscma_yolov5_multi, sscmayolov5);
 }
 
 /* PACKAGE: this is usually set by meson depending on some _INIT macro
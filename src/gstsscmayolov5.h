@@ -49,9 +49,13 @@
 
 #include <gst/gst.h>
 #include <gst/base/gstbasetransform.h>
-#include <gst/video/video-info.h>
+#include <gst/video/video.h>
 #include "tensor_info.h"
-#include <net.h>
+#include "model_cache.h"
+#include "pool_allocator.h"
+#include "postprocess.h"
+#include "motion.h"
+#include "affinity.h"
 
 G_BEGIN_DECLS
 
@@ -75,7 +79,7 @@ G_BEGIN_DECLS
  * @brief Caps string for supported video format
  */
 #define VIDEO_CAPS_STR \
-    GST_VIDEO_CAPS_MAKE ("{ RGB}") \
+    GST_VIDEO_CAPS_MAKE ("{ RGB, BGR, RGBx, BGRx, RGBA, BGRA, NV12, I420, YUY2 }") \
     ", interlace-mode = (string) progressive"
 
 /**
@@ -89,26 +93,117 @@ G_BEGIN_DECLS
 #define append_text_caps_template(caps) \
     gst_caps_append (caps, gst_caps_from_string (TEXT_CAPS_STR))
 
-#define DETECTION_NUM_INFO 5
-#define PIXEL_VALUE                             (0xFF) 
+/**
+ * @brief What the chain function does with a frame when the async queue is full.
+ */
+typedef enum
+{
+  GST_SSCMA_YOLOV5_DROP_BLOCK = 0, /**< wait for the worker to take a frame */
+  GST_SSCMA_YOLOV5_DROP_NEWEST, /**< drop the incoming frame */
+  GST_SSCMA_YOLOV5_DROP_OLDEST, /**< drop the oldest queued frame */
+} GstSscmaYolov5DropPolicy;
 
-/** @brief Represents a detect object */
-typedef struct
+#define GST_TYPE_SSCMAYOLOV5_DROP_POLICY \
+  (gst_sscma_yolov5_drop_policy_get_type())
+GType gst_sscma_yolov5_drop_policy_get_type (void);
+
+/**
+ * @brief Which cores the inference threads run on when no cpu-mask is set.
+ */
+typedef enum
 {
-  int valid;
-  int class_id;
-  int x;
-  int y;
-  int width;
-  int height;
-  gfloat prob;
+  GST_SSCMA_YOLOV5_POWERSAVE_ALL = 0, /**< any core */
+  GST_SSCMA_YOLOV5_POWERSAVE_LITTLE, /**< the little cores of a big.LITTLE SoC */
+  GST_SSCMA_YOLOV5_POWERSAVE_BIG, /**< the big cores of a big.LITTLE SoC */
+} GstSscmaYolov5Powersave;
+
+#define GST_TYPE_SSCMA_DECODER \
+  (gst_sscma_decoder_get_type())
+GType gst_sscma_decoder_get_type (void);
 
-  int tracking_id;
-} detectedObject;
+#define GST_TYPE_SSCMAYOLOV5_POWERSAVE \
+  (gst_sscma_yolov5_powersave_get_type())
+GType gst_sscma_yolov5_powersave_get_type (void);
+
+/**
+ * @brief Affinity a thread was last pinned to, so it is only set again when it changes.
+ */
+typedef struct _GstSscmaYolov5Pinning
+{
+  guint generation; /**< affinity_generation the thread was pinned with */
+  GThread *thread; /**< thread that was pinned */
+} GstSscmaYolov5Pinning;
 
 typedef struct _GstSscmaYolov5 GstSscmaYolov5;
 typedef struct _GstSscmaYolov5Class GstSscmaYolov5Class;
 
+/**
+ * @brief Tiles of one frame being inferred, the caller waits for pending to reach 0.
+ */
+typedef struct _GstSscmaYolov5TileBatch
+{
+  GMutex lock;
+  GCond cond;
+  guint pending; /**< tiles not inferred yet */
+} GstSscmaYolov5TileBatch;
+
+/**
+ * @brief One region of a frame, a ROI or a tile, handed to the tile thread pool.
+ */
+typedef struct _GstSscmaYolov5TileJob
+{
+  const GstSscmaImage *image; /**< the frame */
+  GstSscmaTile tile; /**< region of the frame to infer */
+  GArray *results; /**< detectedObject array, in frame coordinates */
+  GstSscmaYolov5TileBatch *batch; /**< batch the tile belongs to */
+  GstSscmaModel *model; /**< model of the frame, every tile of a frame uses the same */
+  GstSscmaLabels *labels; /**< labels of the frame, may be NULL */
+  GstSscmaResizeTable resize; /**< sampling positions, kept while the region keeps its geometry */
+  guint allocations; /**< ncnn heap allocations the region's inference made */
+} GstSscmaYolov5TileJob;
+
+/**
+ * @brief Per-thread inference state.
+ *
+ * The streaming thread owns one context in sync mode, in async mode every
+ * worker thread owns one, so K workers keep K frames in flight at once.
+ */
+typedef struct _GstSscmaYolov5Context
+{
+  GstSscmaYolov5 *self; /**< the element this context belongs to */
+  GThread *thread; /**< worker thread running this context, NULL in sync mode */
+  int num_threads; /**< ncnn threads given to this context's extractor */
+
+  /* persistent inference state, so that steady-state frames do not hit the heap */
+  GstSscmaCountingAllocator *blob_allocator; /**< blob memory, used by this thread only */
+  GstSscmaCountingAllocator *workspace_allocator; /**< layer workspace memory, locked */
+  GstSscmaModel *model; /**< model the extractor was created from */
+  GstSscmaLabels *labels; /**< labels going with model, NULL if none */
+
+  /* output head, copied from the element's properties when they change */
+  guint head_generation; /**< head_generation of the element the copy was made at */
+  GstSscmaDecoder decoder; /**< output head of the model */
+  gchar *input_blob; /**< name of the input blob */
+  gchar **output_blobs; /**< names of the output blobs */
+  guint num_outs; /**< number of output blobs, at most GST_SSCMA_MAX_OUTPUTS */
+  gfloat anchors[GST_SSCMA_MAX_OUTPUTS][2 * GST_SSCMA_ANCHORS_PER_HEAD]; /**< anchors of raw heads */
+  guint num_anchor_sets; /**< number of anchor sets */
+  gfloat max_score; /**< largest class score of the head, 0 if unknown */
+  GstSscmaDecodeFunc decode; /**< decoder specialized for the last output shape, NULL if none fits */
+  int decode_channels; /**< width of outs[0] decode was picked for */
+  int decode_anchors; /**< height of outs[0] decode was picked for */
+  gboolean decode_selected; /**< TRUE once decode was picked for that shape, even if none fits */
+  ncnn::Extractor *ex; /**< reused across frames, cleared before each one */
+  ncnn::Mat in; /**< preprocessed input, allocated from blob_allocator */
+  GstSscmaResizeTable resize; /**< sampling positions of the whole frame */
+  ncnn::Mat outs[GST_SSCMA_MAX_OUTPUTS]; /**< output blobs, allocated from blob_allocator */
+  GArray *results; /**< detectedObject array reused across frames */
+  GArray *infer_time; /**< guint32 per-stage times reused across frames */
+  GstSscmaYolov5TileJob *tile_jobs; /**< GST_SSCMA_MAX_TILES + 1 jobs, allocated on the first tiled frame */
+  GstSscmaYolov5Pinning pinning; /**< affinity of the thread running this context */
+  guint64 inference; /**< scheduled_inference of the frame this context infers */
+} GstSscmaYolov5Context;
+
 /**
  * @brief GstSscmaYolov5Class inherits GstElementClass.
  *
@@ -131,9 +226,24 @@ typedef struct _GstSscmaYolov5Properties
 {
   const char **model_files; /**< Filepath to the model file (as an argument for NNFW). char instead of gchar for non-glib custom plugins */
   int num_models; /**< number of model files. Some frameworks need multiple model files to initialize the graph (caffe, caffe2) */
+  const char **int8_model_files; /**< int8 quantized bin/param pair, used instead of model_files when set */
+  int num_int8_models; /**< number of int8 model files */
+  char *int8_table; /**< calibration table the int8 model was quantized with */
+  gboolean use_mmap; /**< TRUE to map the weights instead of reading them into memory */
   int num_threads; /**< number of threads for NNFW */
+  ncnn::Option opt; /**< net options applied before load_param, protected by the object lock */
   bool is_output_scaled; /**< TRUE if output tensor is scaled */
+  gboolean letterbox; /**< TRUE to keep the aspect ratio, padding the input to a multiple of 32 */
+
+  /* output head, protected by the object lock */
+  GstSscmaDecoder decoder; /**< how the output blobs hold the boxes */
+  char *input_blob; /**< name of the input blob */
+  char **output_blobs; /**< names of the output blobs, NULL terminated */
+  float anchors[GST_SSCMA_MAX_OUTPUTS][2 * GST_SSCMA_ANCHORS_PER_HEAD]; /**< w,h anchor pairs of raw heads, smallest stride first */
+  guint num_anchor_sets; /**< number of anchor sets */
+  gfloat max_score; /**< largest class score the yolov5 head outputs, 0 if unknown */
 
+  char *labels_file; /**< Filepath to the labels file */
   char **labels; /**< The list of loaded labels. Null if not loaded */
   uint total_labels; /**< The number of loaded labels */
   uint max_word_length; /**< The max size of labels */
@@ -143,25 +253,108 @@ typedef struct _GstSscmaYolov5Properties
   GstTensorsInfo input_meta; /**< configured input tensor info */
   tensors_layout input_layout; /**< data layout info provided as a property to sscma_yolov5 for the input, defaults to _NNS_LAYOUT_ANY for all the tensors */
   unsigned int input_ranks[NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT];  /**< the rank list of input tensors, it is calculated based on the dimension string. */
+  gboolean input_configured; /**< TRUE if input_meta was set by the user, FALSE if derived from the model */
 
   GstTensorsInfo output_meta; /**< configured output tensor info */
   tensors_layout output_layout; /**< data layout info provided as a property to sscma_yolov5 for the output, defaults to _NNS_LAYOUT_ANY for all the tensors */
   unsigned int output_ranks[NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT];  /**< the rank list of output tensors, it is calculated based on the dimension string. */
+  gboolean output_configured; /**< TRUE if output_meta was set by the user, FALSE if derived from the model */
 } GstSscmaYolov5Properties;
 
+void loadImageLabels (const char *label_path, GstSscmaYolov5Properties * prop);
+gboolean gst_sscma_image_from_video_frame (GstSscmaImage * image,
+    const GstVideoFrame * frame);
+gboolean gst_sscma_propose_allocation (GstPad * pad, GstObject * parent,
+    GstQuery * query);
+
 struct _GstSscmaYolov5
 {
   GstElement element;
 
   GstPad *sinkpad, *srcpad;
 
-  ncnn::Net net; /**< NNFW's net object */
+  GstSscmaModel *model; /**< shared, refcounted network loaded from model_files, protected by the object lock */
+  GstSscmaLabels *labels; /**< class names loaded from labels_file, protected by the object lock */
+  guint warmup_runs; /**< inferences run on every context before the first frame */
+  gdouble load_time; /**< ms spent loading the model, protected by the object lock */
+  gdouble warmup_time; /**< ms spent in warm-up inferences, protected by the object lock */
+
+  /* model hot-swap, protected by the object lock */
+  gboolean started; /**< TRUE between READY to PAUSED and PAUSED to READY */
+  guint config_generation; /**< bumped by every change of the model or labels files */
+  gboolean reloading; /**< TRUE while reload_thread loads a new model */
+  GThread *reload_thread; /**< loads a new model and labels in the background */
+  guint head_generation; /**< bumped by every change of the output head properties */
 
   int rate_n; /**< framerate is in fraction, which is numerator/denominator */
   int rate_d; /**< framerate is in fraction, which is numerator/denominator */
   GstTensorsInfo input_info; /**< input tensor info */
+  GstVideoInfo vinfo; /**< negotiated input format */
 
   GstSscmaYolov5Properties prop; /**< NNFW plugin's properties */
+
+  /* async inference, all fields below are protected by queue_lock */
+  gboolean async; /**< TRUE to run inference on worker threads */
+  guint inflight; /**< number of async workers, i.e. frames in flight */
+  guint max_queue_size; /**< max number of frames waiting for the worker */
+  GstSscmaYolov5DropPolicy drop_policy; /**< what to do when the queue is full */
+  GQueue queue; /**< pending buffers and serialized events, in stream order */
+  guint queued_buffers; /**< number of buffers in queue */
+  guint64 dropped; /**< number of frames dropped by the drop policy */
+  GMutex queue_lock;
+  GCond queue_cond;
+  GstSscmaYolov5Context *contexts; /**< inference contexts, set between READY and PAUSED */
+  guint num_contexts; /**< number of contexts */
+  gboolean running_async; /**< TRUE if the contexts run on worker threads */
+  gboolean worker_stop; /**< TRUE to make the workers exit */
+  gboolean flushing; /**< TRUE between FLUSH_START and FLUSH_STOP */
+  guint busy; /**< number of items the workers are handling */
+  guint64 pop_seq; /**< sequence number given to the next item taken from queue */
+  guint64 push_seq; /**< sequence number of the next item allowed downstream */
+  GstFlowReturn last_flow; /**< last downstream flow return seen by the workers */
+
+  /* inference interval, all fields below are protected by queue_lock */
+  guint interval; /**< infer every Nth frame, the longest interval in adaptive mode */
+  gdouble max_rate; /**< max inferences per second of stream time, 0 for no limit */
+  gboolean adaptive_interval; /**< TRUE to adapt the interval to how much detections change */
+  guint current_interval; /**< interval in use in adaptive mode */
+  gboolean inference_scheduled; /**< TRUE once a frame was scheduled for inference */
+  guint frames_since_inference; /**< frames reusing detections since the last inferred one */
+  GstClockTime last_inference_ts; /**< timestamp of the last inferred frame */
+  GArray *last_results; /**< detectedObject array of the last inferred frame */
+  guint64 schedule_ticket; /**< turn given to the next frame to schedule */
+  guint64 schedule_turn; /**< turn of the frame allowed to schedule */
+  guint64 scheduled_inference; /**< number of the last frame scheduled for inference */
+  guint64 stored_inference; /**< number of the inferred frame last_results comes from */
+  guint64 reused; /**< number of frames that reused the last detections */
+
+  /* motion gating, protected by queue_lock */
+  gdouble motion_threshold; /**< fraction of thumbnail pixels that must change, 0 to disable */
+  guint motion_pixel_threshold; /**< luma difference above which a pixel has changed */
+  guint8 motion_reference[GST_SSCMA_MOTION_SIZE]; /**< luma thumbnail of the last inferred frame */
+  gboolean have_motion_reference; /**< TRUE once motion_reference was filled */
+  guint64 motion_skipped; /**< number of frames that reused detections for lack of motion */
+
+  /* tiled inference, the parameters are protected by queue_lock */
+  guint tile_size; /**< side of a tile in frame pixels, 0 to infer the whole frame */
+  gdouble tile_overlap; /**< min overlap of neighbour tiles, as a fraction of a tile */
+  guint max_tiles; /**< max number of tiles, they grow to fit */
+  gboolean tile_global; /**< TRUE to also infer the whole frame, downscaled */
+  GstSscmaYolov5Context *tile_contexts; /**< one single-threaded context per tile thread */
+  guint num_tile_contexts; /**< number of tile contexts */
+  GAsyncQueue *tile_free; /**< tile contexts not in use */
+  GThreadPool *tile_pool; /**< runs GstSscmaYolov5TileJob, NULL if tiling is off */
+
+  GArray *rois; /**< GstSscmaTile regions of interest, empty for the whole frame, protected by queue_lock */
+
+  /* CPU affinity, protected by queue_lock */
+  GstSscmaYolov5Powersave powersave; /**< cores of the inference threads when cpu_mask is not set */
+  gchar *cpu_mask; /**< CPU list of the inference threads, e.g. "4-7", NULL for powersave */
+  gchar *streaming_cpu_mask; /**< CPU list of the streaming thread, NULL to follow cpu_mask in sync mode and leave it alone in async mode */
+  guint affinity_generation; /**< bumped by every affinity change, 0 until the first one */
+  GstSscmaYolov5Pinning streaming_pinning; /**< affinity of the streaming thread */
+
+  guint allocations; /**< atomic, ncnn heap allocations of the last inferred frame */
 };
 
 G_END_DECLS
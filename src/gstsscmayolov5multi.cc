@@ -0,0 +1,1043 @@
+/**
+ * SECTION:element-sscma_yolov5_multi
+ *
+ * Runs one yolov5 network over several camera streams. Every sink_%u request
+ * pad gets a matching src_%u pad carrying its frames with boxes drawn, or its
+ * detections as text/x-json when downstream does not take video.
+ *
+ * A single inference thread owns the network and the numthreads budget, and a
+ * scheduler picks whose newest frame it infers next, so 8 cameras cost one
+ * network's worth of cores instead of oversubscribing the CPU 8 times.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 sscma_yolov5_multi name=m model=net.bin,net.param labels=labels.txt \
+ *     v4l2src device=/dev/video0 ! video/x-raw,format=YUY2 ! m.sink_0 \
+ *     v4l2src device=/dev/video2 ! video/x-raw,format=YUY2 ! m.sink_1 \
+ *     m.src_0 ! videoconvert ! autovideosink  m.src_1 ! videoconvert ! autovideosink
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <gst/gst.h>
+
+#include "gstsscmayolov5multi.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_sscma_yolov5_multi_debug);
+#define GST_CAT_DEFAULT gst_sscma_yolov5_multi_debug
+
+enum
+{
+  PROP_0,
+  PROP_MODEL,
+  PROP_MODE_LABELS,
+  PROP_INPUT,
+  PROP_THRESHOLD,
+  PROP_NUMTHREADS,
+  PROP_IS_OUTPUT_SCALED,
+  PROP_MAX_SCORE,
+  PROP_LETTERBOX,
+  PROP_MMAP,
+  PROP_SCHEDULE,
+  PROP_STATS,
+};
+
+#define DEFAULT_SCHEDULE GST_SSCMA_YOLOV5_MULTI_ROUND_ROBIN
+
+#define gst_sscma_yolov5_multi_parent_class parent_class
+G_DEFINE_TYPE (GstSscmaYolov5Multi, gst_sscma_yolov5_multi, GST_TYPE_ELEMENT);
+
+GST_ELEMENT_REGISTER_DEFINE (sscma_yolov5_multi, "sscma_yolov5_multi",
+    GST_RANK_NONE, GST_TYPE_SSCMAYOLOV5MULTI);
+
+GType
+gst_sscma_yolov5_multi_schedule_get_type (void)
+{
+  static GType schedule_type = 0;
+  static const GEnumValue schedule[] = {
+    {GST_SSCMA_YOLOV5_MULTI_ROUND_ROBIN,
+        "Streams with a frame waiting take turns", "round-robin"},
+    {GST_SSCMA_YOLOV5_MULTI_DEADLINE,
+        "The stream whose next frame is due first goes first", "deadline"},
+    {0, NULL, NULL},
+  };
+
+  if (!schedule_type) {
+    schedule_type =
+        g_enum_register_static ("GstSscmaYolov5MultiSchedule", schedule);
+  }
+  return schedule_type;
+}
+
+static void gst_sscma_yolov5_multi_set_property (GObject * object,
+    guint prop_id, const GValue * value, GParamSpec * pspec);
+static void gst_sscma_yolov5_multi_get_property (GObject * object,
+    guint prop_id, GValue * value, GParamSpec * pspec);
+static void gst_sscma_yolov5_multi_finalize (GObject * object);
+static GstStateChangeReturn gst_sscma_yolov5_multi_change_state (GstElement *
+    element, GstStateChange transition);
+static GstPad *gst_sscma_yolov5_multi_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps);
+static void gst_sscma_yolov5_multi_release_pad (GstElement * element,
+    GstPad * pad);
+
+static gboolean gst_sscma_yolov5_multi_sink_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
+static gboolean gst_sscma_yolov5_multi_sink_query (GstPad * pad,
+    GstObject * parent, GstQuery * query);
+static GstFlowReturn gst_sscma_yolov5_multi_chain (GstPad * pad,
+    GstObject * parent, GstBuffer * buf);
+static GstIterator *gst_sscma_yolov5_multi_iterate_internal_links (GstPad *
+    pad, GstObject * parent);
+static gpointer gst_sscma_yolov5_multi_worker (gpointer data);
+
+/* initialize the sscma_yolov5_multi's class */
+static void
+gst_sscma_yolov5_multi_class_init (GstSscmaYolov5MultiClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GstPadTemplate *pad_template;
+  GstCaps *pad_caps;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+
+  GST_DEBUG_CATEGORY_INIT (gst_sscma_yolov5_multi_debug, "sscmayolov5multi",
+      0, "sscma yolov5 multi-stream");
+
+  gobject_class->set_property = gst_sscma_yolov5_multi_set_property;
+  gobject_class->get_property = gst_sscma_yolov5_multi_get_property;
+  gobject_class->finalize = gst_sscma_yolov5_multi_finalize;
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_sscma_yolov5_multi_change_state);
+  gstelement_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_sscma_yolov5_multi_request_new_pad);
+  gstelement_class->release_pad =
+      GST_DEBUG_FUNCPTR (gst_sscma_yolov5_multi_release_pad);
+
+  g_object_class_install_property (gobject_class, PROP_MODEL,
+      g_param_spec_string ("model", "Model filepath",
+          "File paths to the model bin,param pair shared by every stream",
+          "", (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MODE_LABELS,
+      g_param_spec_string ("labels", "Labels file",
+          "Configure the Labels file path.", "",
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_INPUT,
+      g_param_spec_string ("input", "Input dimension",
+          "Model input dimension, color:width:height", "3:320:320",
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_THRESHOLD,
+      g_param_spec_string ("threshold", "Threshold",
+          "Detection score and NMS IoU thresholds, score:iou", "2500:0.25",
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_NUMTHREADS,
+      g_param_spec_int ("numthreads", "Number of threads",
+          "Number of threads for NNFW, shared by every stream", 1, 4, 4,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_IS_OUTPUT_SCALED,
+      g_param_spec_boolean ("is_output_scaled", "Is output scaled",
+          "Is output scaled", TRUE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_SCORE,
+      g_param_spec_float ("max-score", "Max class score",
+          "Largest class score the model outputs, 100 for percents, 1 for "
+          "probabilities. 0 if unknown",
+          0, G_MAXFLOAT, 100.f,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_LETTERBOX,
+      g_param_spec_boolean ("letterbox", "Letterbox",
+          "Keep each frame's aspect ratio, padding the input to a multiple of 32",
+          FALSE, (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MMAP,
+      g_param_spec_boolean ("mmap", "Memory-map the model",
+          "Map the model files and use the weights in place from the page cache",
+          FALSE, (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_SCHEDULE,
+      g_param_spec_enum ("schedule", "Schedule",
+          "How the inference thread picks the stream to serve next",
+          GST_TYPE_SSCMAYOLOV5_MULTI_SCHEDULE, DEFAULT_SCHEDULE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Per stream frames, inferred, dropped and fps, one sink_N field each",
+          GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  /* set src pad template */
+  pad_caps = gst_caps_new_empty ();
+  append_video_caps_template (pad_caps);
+  append_text_caps_template (pad_caps);
+  pad_template = gst_pad_template_new ("src_%u", GST_PAD_SRC, GST_PAD_SOMETIMES,
+      pad_caps);
+  gst_element_class_add_pad_template (gstelement_class, pad_template);
+  gst_caps_unref (pad_caps);
+
+  /* set sink pad template */
+  pad_caps = gst_caps_new_empty ();
+  append_video_caps_template (pad_caps);
+  pad_template = gst_pad_template_new ("sink_%u", GST_PAD_SINK, GST_PAD_REQUEST,
+      pad_caps);
+  gst_element_class_add_pad_template (gstelement_class, pad_template);
+  gst_caps_unref (pad_caps);
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "SscmaYolov5Multi",
+      "Filter/Video",
+      "yolov5 over several streams sharing one network",
+      "qian <<ruiqian.tang@seeed.org>>");
+}
+
+static void
+gst_sscma_yolov5_multi_init (GstSscmaYolov5Multi * self)
+{
+  GstSscmaYolov5Properties *prop = &self->prop;
+
+  memset (prop, 0, sizeof (GstSscmaYolov5Properties));
+  prop->num_threads = 4;
+  prop->opt = ncnn::Option ();
+  prop->is_output_scaled = TRUE;
+  prop->max_score = 100.f;
+  prop->threshold[0] = 2500;
+  prop->threshold[1] = 0.25;
+  gst_tensors_info_init (&prop->input_meta);
+  prop->input_meta.num_tensors = 1;
+  prop->input_ranks[0] = gst_tensor_parse_dimension ("3:320:320",
+      prop->input_meta.info[0].dimension);
+
+  self->schedule = DEFAULT_SCHEDULE;
+  self->model = NULL;
+  g_mutex_init (&self->lock);
+  g_cond_init (&self->cond);
+  self->streams = g_ptr_array_new ();
+  self->next_index = 0;
+}
+
+static void
+gst_sscma_yolov5_multi_finalize (GObject * object)
+{
+  GstSscmaYolov5Multi *self = GST_SSCMA_YOLOV5_MULTI (object);
+  GstSscmaYolov5Properties *prop = &self->prop;
+  guint i;
+
+  for (i = 0; i < prop->total_labels; i++)
+    g_free (prop->labels[i]);
+  g_free (prop->labels);
+  g_free (prop->labels_file);
+  g_strfreev ((gchar **) prop->model_files);
+  gst_tensors_info_free (&prop->input_meta);
+  if (self->model)
+    gst_sscma_model_unref (self->model);
+  /* release_pad freed the streams */
+  g_ptr_array_free (self->streams, TRUE);
+  g_mutex_clear (&self->lock);
+  g_cond_clear (&self->cond);
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_sscma_yolov5_multi_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstSscmaYolov5Multi *self = GST_SSCMA_YOLOV5_MULTI (object);
+  GstSscmaYolov5Properties *prop = &self->prop;
+
+  switch (prop_id) {
+    case PROP_MODEL:
+      g_strfreev ((gchar **) prop->model_files);
+      prop->model_files = NULL;
+      prop->num_models = 0;
+      if (g_value_get_string (value)) {
+        prop->model_files = (const gchar **)
+            g_strsplit_set (g_value_get_string (value), ",", -1);
+        prop->num_models = g_strv_length ((gchar **) prop->model_files);
+      }
+      break;
+    case PROP_MODE_LABELS:
+      g_free (prop->labels_file);
+      prop->labels_file = g_value_dup_string (value);
+      if (prop->labels_file)
+        loadImageLabels (prop->labels_file, prop);
+      break;
+    case PROP_INPUT:
+      if (g_value_get_string (value))
+        prop->input_ranks[0] = gst_tensor_parse_dimension (
+            g_value_get_string (value), prop->input_meta.info[0].dimension);
+      break;
+    case PROP_THRESHOLD:
+    {
+      gchar **options;
+      guint i;
+
+      if (!g_value_get_string (value))
+        break;
+      options = g_strsplit (g_value_get_string (value), ":", 2);
+      for (i = 0; options[i]; i++)
+        prop->threshold[i] = g_ascii_strtod (options[i], NULL);
+      g_strfreev (options);
+      break;
+    }
+    case PROP_NUMTHREADS:
+      prop->num_threads = g_value_get_int (value);
+      break;
+    case PROP_IS_OUTPUT_SCALED:
+      prop->is_output_scaled = g_value_get_boolean (value);
+      break;
+    case PROP_MAX_SCORE:
+      prop->max_score = g_value_get_float (value);
+      break;
+    case PROP_LETTERBOX:
+      prop->letterbox = g_value_get_boolean (value);
+      break;
+    case PROP_MMAP:
+      prop->use_mmap = g_value_get_boolean (value);
+      break;
+    case PROP_SCHEDULE:
+      g_mutex_lock (&self->lock);
+      self->schedule = (GstSscmaYolov5MultiSchedule) g_value_get_enum (value);
+      g_mutex_unlock (&self->lock);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/**
+ * @brief Build the stats structure: one sink_N field per stream.
+ */
+static GstStructure *
+gst_sscma_yolov5_multi_get_stats (GstSscmaYolov5Multi * self)
+{
+  GstStructure *stats = gst_structure_new_empty ("sscma-yolov5-multi-stats");
+  guint i;
+
+  g_mutex_lock (&self->lock);
+  for (i = 0; i < self->streams->len; i++) {
+    GstSscmaYolov5MultiStream *stream =
+        (GstSscmaYolov5MultiStream *) g_ptr_array_index (self->streams, i);
+    GstStructure *s;
+    gchar *name;
+
+    s = gst_structure_new ("stream",
+        "frames", G_TYPE_UINT64, stream->frames,
+        "inferred", G_TYPE_UINT64, stream->inferred,
+        "dropped", G_TYPE_UINT64, stream->dropped,
+        "fps", G_TYPE_DOUBLE, stream->fps, NULL);
+    name = g_strdup_printf ("sink_%u", stream->index);
+    gst_structure_take (stats, name, GST_TYPE_STRUCTURE, s);
+    g_free (name);
+  }
+  g_mutex_unlock (&self->lock);
+
+  return stats;
+}
+
+static void
+gst_sscma_yolov5_multi_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstSscmaYolov5Multi *self = GST_SSCMA_YOLOV5_MULTI (object);
+  GstSscmaYolov5Properties *prop = &self->prop;
+
+  switch (prop_id) {
+    case PROP_MODEL:
+      g_value_take_string (value, prop->model_files ?
+          g_strjoinv (",", (gchar **) prop->model_files) : NULL);
+      break;
+    case PROP_MODE_LABELS:
+      g_value_set_string (value, prop->labels_file);
+      break;
+    case PROP_INPUT:
+      g_value_take_string (value,
+          gst_tensor_get_dimension_string (prop->input_meta.info[0].dimension));
+      break;
+    case PROP_THRESHOLD:
+    {
+      gchar score[G_ASCII_DTOSTR_BUF_SIZE], iou[G_ASCII_DTOSTR_BUF_SIZE];
+
+      g_ascii_formatd (score, sizeof (score), "%g", prop->threshold[0]);
+      g_ascii_formatd (iou, sizeof (iou), "%g", prop->threshold[1]);
+      g_value_take_string (value, g_strdup_printf ("%s:%s", score, iou));
+      break;
+    }
+    case PROP_NUMTHREADS:
+      g_value_set_int (value, prop->num_threads);
+      break;
+    case PROP_IS_OUTPUT_SCALED:
+      g_value_set_boolean (value, prop->is_output_scaled);
+      break;
+    case PROP_MAX_SCORE:
+      g_value_set_float (value, prop->max_score);
+      break;
+    case PROP_LETTERBOX:
+      g_value_set_boolean (value, prop->letterbox);
+      break;
+    case PROP_MMAP:
+      g_value_set_boolean (value, prop->use_mmap);
+      break;
+    case PROP_SCHEDULE:
+      g_mutex_lock (&self->lock);
+      g_value_set_enum (value, self->schedule);
+      g_mutex_unlock (&self->lock);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_sscma_yolov5_multi_get_stats (self));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/**
+ * @brief Find a stream by its pad index. Must be called with the lock held.
+ */
+static GstSscmaYolov5MultiStream *
+gst_sscma_yolov5_multi_find_stream (GstSscmaYolov5Multi * self, guint index)
+{
+  guint i;
+
+  for (i = 0; i < self->streams->len; i++) {
+    GstSscmaYolov5MultiStream *stream =
+        (GstSscmaYolov5MultiStream *) g_ptr_array_index (self->streams, i);
+    if (stream->index == index)
+      return stream;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Create a sink_%u pad and the src_%u pad its results go out of.
+ */
+static GstPad *
+gst_sscma_yolov5_multi_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+  GstSscmaYolov5Multi *self = GST_SSCMA_YOLOV5_MULTI (element);
+  GstSscmaYolov5MultiStream *stream;
+  gchar *pad_name;
+  guint index;
+  UNUSED (caps);
+
+  g_mutex_lock (&self->lock);
+  if (name == NULL || sscanf (name, "sink_%u", &index) != 1
+      || gst_sscma_yolov5_multi_find_stream (self, index))
+    index = self->next_index;
+  self->next_index = MAX (self->next_index, index + 1);
+
+  stream = g_new0 (GstSscmaYolov5MultiStream, 1);
+  stream->index = index;
+  stream->last_flow = GST_FLOW_OK;
+  gst_video_info_init (&stream->vinfo);
+  g_ptr_array_add (self->streams, stream);
+  g_mutex_unlock (&self->lock);
+
+  pad_name = g_strdup_printf ("sink_%u", index);
+  stream->sinkpad = gst_pad_new_from_template (templ, pad_name);
+  g_free (pad_name);
+  gst_pad_set_element_private (stream->sinkpad, stream);
+  gst_pad_set_event_function (stream->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_sscma_yolov5_multi_sink_event));
+  gst_pad_set_query_function (stream->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_sscma_yolov5_multi_sink_query));
+  gst_pad_set_chain_function (stream->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_sscma_yolov5_multi_chain));
+  gst_pad_set_iterate_internal_links_function (stream->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_sscma_yolov5_multi_iterate_internal_links));
+
+  pad_name = g_strdup_printf ("src_%u", index);
+  stream->srcpad = gst_pad_new_from_template (gst_element_class_get_pad_template
+      (GST_ELEMENT_GET_CLASS (self), "src_%u"), pad_name);
+  g_free (pad_name);
+  gst_pad_set_element_private (stream->srcpad, stream);
+  gst_pad_set_iterate_internal_links_function (stream->srcpad,
+      GST_DEBUG_FUNCPTR (gst_sscma_yolov5_multi_iterate_internal_links));
+
+  /* added pads are activated if the element already runs */
+  gst_element_add_pad (element, stream->srcpad);
+  gst_element_add_pad (element, stream->sinkpad);
+
+  return stream->sinkpad;
+}
+
+/**
+ * @brief Remove a stream, once the inference thread is done with it.
+ */
+static void
+gst_sscma_yolov5_multi_release_pad (GstElement * element, GstPad * pad)
+{
+  GstSscmaYolov5Multi *self = GST_SSCMA_YOLOV5_MULTI (element);
+  GstSscmaYolov5MultiStream *stream =
+      (GstSscmaYolov5MultiStream *) gst_pad_get_element_private (pad);
+
+  g_mutex_lock (&self->lock);
+  g_ptr_array_remove (self->streams, stream);
+  while (stream->busy)
+    g_cond_wait (&self->cond, &self->lock);
+  gst_clear_buffer (&stream->pending);
+  g_mutex_unlock (&self->lock);
+
+  gst_element_remove_pad (element, stream->srcpad);
+  gst_element_remove_pad (element, stream->sinkpad);
+  gst_sscma_resize_table_clear (&stream->resize);
+  g_free (stream);
+}
+
+/**
+ * @brief Events and queries of a stream's pads go to the other pad of the same stream.
+ */
+static GstIterator *
+gst_sscma_yolov5_multi_iterate_internal_links (GstPad * pad, GstObject * parent)
+{
+  GstSscmaYolov5MultiStream *stream =
+      (GstSscmaYolov5MultiStream *) gst_pad_get_element_private (pad);
+  GValue val = G_VALUE_INIT;
+  GstIterator *it;
+  UNUSED (parent);
+
+  g_value_init (&val, GST_TYPE_PAD);
+  g_value_set_object (&val,
+      pad == stream->sinkpad ? stream->srcpad : stream->sinkpad);
+  it = gst_iterator_new_single (GST_TYPE_PAD, &val);
+  g_value_unset (&val);
+
+  return it;
+}
+
+/**
+ * @brief Wait until the stream's waiting frame, if any, has been pushed.
+ */
+static void
+gst_sscma_yolov5_multi_drain (GstSscmaYolov5Multi * self,
+    GstSscmaYolov5MultiStream * stream)
+{
+  g_mutex_lock (&self->lock);
+  while (self->worker && !self->worker_stop && !stream->flushing
+      && (stream->pending || stream->busy))
+    g_cond_wait (&self->cond, &self->lock);
+  g_mutex_unlock (&self->lock);
+}
+
+/**
+ * @brief Negotiate a stream: video with boxes if downstream takes the input caps, json otherwise.
+ */
+static gboolean
+gst_sscma_yolov5_multi_set_caps (GstSscmaYolov5Multi * self,
+    GstSscmaYolov5MultiStream * stream, GstCaps * caps)
+{
+  GstVideoInfo vinfo;
+  GstCaps *out_caps;
+  gboolean output_json, ret;
+
+  if (!gst_video_info_from_caps (&vinfo, caps)) {
+    GST_ERROR_OBJECT (stream->sinkpad, "Cannot parse caps %" GST_PTR_FORMAT,
+        caps);
+    return FALSE;
+  }
+
+  output_json = !gst_pad_peer_query_accept_caps (stream->srcpad, caps);
+  out_caps = output_json ? gst_caps_from_string (TEXT_CAPS_STR)
+      : gst_caps_ref (caps);
+
+  g_mutex_lock (&self->lock);
+  stream->vinfo = vinfo;
+  stream->output_json = output_json;
+  g_mutex_unlock (&self->lock);
+
+  ret = gst_pad_set_caps (stream->srcpad, out_caps);
+  gst_caps_unref (out_caps);
+  return ret;
+}
+
+/**
+ * @brief This function handles sink event.
+ */
+static gboolean
+gst_sscma_yolov5_multi_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstSscmaYolov5Multi *self = GST_SSCMA_YOLOV5_MULTI (parent);
+  GstSscmaYolov5MultiStream *stream =
+      (GstSscmaYolov5MultiStream *) gst_pad_get_element_private (pad);
+  gboolean ret;
+
+  GST_DEBUG_OBJECT (pad, "Received %s event: %" GST_PTR_FORMAT,
+      GST_EVENT_TYPE_NAME (event), event);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      g_mutex_lock (&self->lock);
+      stream->flushing = TRUE;
+      gst_clear_buffer (&stream->pending);
+      g_cond_broadcast (&self->cond);
+      g_mutex_unlock (&self->lock);
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      g_mutex_lock (&self->lock);
+      while (stream->busy)
+        g_cond_wait (&self->cond, &self->lock);
+      stream->flushing = FALSE;
+      stream->last_flow = GST_FLOW_OK;
+      g_mutex_unlock (&self->lock);
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+    case GST_EVENT_CAPS:
+    {
+      GstCaps *caps;
+
+      /* the waiting frame was negotiated with the previous caps */
+      gst_sscma_yolov5_multi_drain (self, stream);
+      gst_event_parse_caps (event, &caps);
+      ret = gst_sscma_yolov5_multi_set_caps (self, stream, caps);
+      gst_event_unref (event);
+      break;
+    }
+    default:
+      /* keep serialized events behind the frame waiting for inference */
+      if (GST_EVENT_IS_SERIALIZED (event))
+        gst_sscma_yolov5_multi_drain (self, stream);
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+  }
+
+  return ret;
+}
+
+/**
+ * @brief This function handles sink query.
+ */
+static gboolean
+gst_sscma_yolov5_multi_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstSscmaYolov5Multi *self = GST_SSCMA_YOLOV5_MULTI (parent);
+  GstSscmaYolov5MultiStream *stream =
+      (GstSscmaYolov5MultiStream *) gst_pad_get_element_private (pad);
+  gboolean output_json, ret;
+
+  if (GST_QUERY_TYPE (query) != GST_QUERY_ALLOCATION)
+    return gst_pad_query_default (pad, parent, query);
+
+  g_mutex_lock (&self->lock);
+  output_json = stream->output_json;
+  g_mutex_unlock (&self->lock);
+
+  /* video out: the frames go downstream, let it pick the pool */
+  if (!output_json)
+    ret = gst_pad_query_default (pad, parent, query);
+  else
+    ret = gst_sscma_propose_allocation (pad, parent, query);
+  /* frames are mapped with their video meta, padded strides are fine */
+  if (ret && !gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE,
+          NULL))
+    gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+
+  return ret;
+}
+
+/**
+ * @brief Chain function, makes the frame its stream's newest and returns at once.
+ */
+static GstFlowReturn
+gst_sscma_yolov5_multi_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  GstSscmaYolov5Multi *self = GST_SSCMA_YOLOV5_MULTI (parent);
+  GstSscmaYolov5MultiStream *stream =
+      (GstSscmaYolov5MultiStream *) gst_pad_get_element_private (pad);
+  GstFlowReturn ret;
+  gint64 now = g_get_monotonic_time ();
+
+  g_mutex_lock (&self->lock);
+  /* stopped, not an error: the pads are being deactivated */
+  if (self->worker == NULL) {
+    g_mutex_unlock (&self->lock);
+    gst_buffer_unref (buf);
+    return GST_FLOW_FLUSHING;
+  }
+
+  ret = stream->flushing ? GST_FLOW_FLUSHING : stream->last_flow;
+  if (ret != GST_FLOW_OK) {
+    g_mutex_unlock (&self->lock);
+    gst_buffer_unref (buf);
+    return ret;
+  }
+
+  stream->frames++;
+  if (stream->pending) {
+    GST_LOG_OBJECT (pad, "Replacing frame %" GST_PTR_FORMAT, stream->pending);
+    gst_buffer_unref (stream->pending);
+    stream->dropped++;
+  }
+  stream->pending = buf;
+  /* by the time the next frame arrives this one is stale */
+  stream->deadline = now;
+  if (GST_VIDEO_INFO_FPS_N (&stream->vinfo) > 0)
+    stream->deadline += gst_util_uint64_scale_int (G_USEC_PER_SEC,
+        GST_VIDEO_INFO_FPS_D (&stream->vinfo),
+        GST_VIDEO_INFO_FPS_N (&stream->vinfo));
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->lock);
+
+  return GST_FLOW_OK;
+}
+
+/**
+ * @brief Pick the stream to infer next. Must be called with the lock held.
+ * @return NULL if no stream has a frame waiting
+ */
+static GstSscmaYolov5MultiStream *
+gst_sscma_yolov5_multi_schedule (GstSscmaYolov5Multi * self)
+{
+  GstSscmaYolov5MultiStream *best = NULL;
+  const guint n = self->streams->len;
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    const guint pos = (self->cursor + i) % n;
+    GstSscmaYolov5MultiStream *stream =
+        (GstSscmaYolov5MultiStream *) g_ptr_array_index (self->streams, pos);
+
+    if (stream->pending == NULL || stream->busy)
+      continue;
+
+    if (self->schedule == GST_SSCMA_YOLOV5_MULTI_ROUND_ROBIN) {
+      self->cursor = pos + 1;
+      return stream;
+    }
+    if (best == NULL || stream->deadline < best->deadline)
+      best = stream;
+  }
+
+  return best;
+}
+
+/**
+ * @brief Create the inference state on the loaded model.
+ */
+static void
+gst_sscma_yolov5_multi_context_init (GstSscmaYolov5Multi * self)
+{
+  self->blob_pool = new ncnn::UnlockedPoolAllocator ();
+  self->workspace_pool = new ncnn::PoolAllocator ();
+  self->ex = new ncnn::Extractor (self->model->net.create_extractor ());
+  self->ex->set_num_threads (self->prop.num_threads);
+  self->ex->set_blob_allocator (self->blob_pool);
+  self->ex->set_workspace_allocator (self->workspace_pool);
+  self->results = g_array_new (FALSE, TRUE, sizeof (detectedObject));
+  self->infer_time = g_array_sized_new (FALSE, TRUE, sizeof (guint32), 3);
+}
+
+/**
+ * @brief Release the inference state.
+ */
+static void
+gst_sscma_yolov5_multi_context_clear (GstSscmaYolov5Multi * self)
+{
+  /* blobs go back to the pools before the pools go away */
+  delete self->ex;
+  self->ex = NULL;
+  self->in.release ();
+  self->out.release ();
+  delete self->blob_pool;
+  delete self->workspace_pool;
+  self->blob_pool = NULL;
+  self->workspace_pool = NULL;
+  if (self->results)
+    g_array_free (self->results, TRUE);
+  if (self->infer_time)
+    g_array_free (self->infer_time, TRUE);
+  self->results = self->infer_time = NULL;
+}
+
+/**
+ * @brief Preprocess, infer and decode one frame of a stream.
+ * @param buf the frame, always consumed
+ * @param[out] outbuf the buffer to push on success
+ */
+static GstFlowReturn
+gst_sscma_yolov5_multi_process (GstSscmaYolov5Multi * self,
+    GstSscmaYolov5MultiStream * stream, GstBuffer * buf, GstBuffer ** outbuf)
+{
+  GstSscmaYolov5Properties *prop = &self->prop;
+  GstSscmaInputTransform transform;
+  GstSscmaDecodeParams params;
+  GstVideoInfo vinfo;
+  GstSscmaImage image;
+  GstVideoFrame frame;
+  gboolean output_json;
+  gint64 start, now;
+  guint32 stage;
+  int width, height;
+
+  g_mutex_lock (&self->lock);
+  vinfo = stream->vinfo;
+  output_json = stream->output_json;
+  g_mutex_unlock (&self->lock);
+
+  width = GST_VIDEO_INFO_WIDTH (&vinfo);
+  height = GST_VIDEO_INFO_HEIGHT (&vinfo);
+
+  if (!output_json)
+    buf = gst_buffer_make_writable (buf);
+  /* honors the strides and plane offsets of a GstVideoMeta, if any */
+  if (!gst_video_frame_map (&frame, &vinfo, buf,
+          output_json ? GST_MAP_READ : GST_MAP_READWRITE)) {
+    GST_ERROR_OBJECT (stream->sinkpad, "Cannot map frame");
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+  if (!gst_sscma_image_from_video_frame (&image, &frame)) {
+    GST_ERROR_OBJECT (stream->sinkpad, "Unsupported format %s",
+        GST_VIDEO_INFO_NAME (&vinfo));
+    gst_video_frame_unmap (&frame);
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+
+  if (prop->letterbox)
+    gst_sscma_input_transform_letterbox (width, height,
+        MAX (prop->input_meta.info[0].dimension[1],
+            prop->input_meta.info[0].dimension[2]),
+        GST_SSCMA_LETTERBOX_ALIGN, &transform);
+  else
+    gst_sscma_input_transform_stretch (width, height,
+        prop->input_meta.info[0].dimension[1],
+        prop->input_meta.info[0].dimension[2], &transform);
+
+  g_array_set_size (self->infer_time, 0);
+  start = g_get_monotonic_time ();
+  gst_sscma_preprocess_transform (&image, &transform, &stream->resize,
+      self->in, self->blob_pool);
+  now = g_get_monotonic_time ();
+  stage = (guint32) ((now - start) / 1000);
+  g_array_append_val (self->infer_time, stage);
+
+  start = now;
+  self->ex->clear ();
+  if (self->model->input_index >= 0) {
+    self->ex->input (self->model->input_index, self->in);
+    self->ex->extract (self->model->output_index, self->out);
+  } else {
+    self->ex->input ("in0", self->in);
+    self->ex->extract ("out0", self->out);
+  }
+  now = g_get_monotonic_time ();
+  stage = (guint32) ((now - start) / 1000);
+  g_array_append_val (self->infer_time, stage);
+
+  start = now;
+  g_array_set_size (self->results, 0);
+  params.threshold = prop->threshold[0];
+  params.is_output_scaled = prop->is_output_scaled;
+  params.transform = &transform;
+  params.width = width;
+  params.height = height;
+  params.anchors = NULL;
+  params.num_anchor_sets = 0;
+  params.max_score = prop->max_score;
+  gst_sscma_decode (GST_SSCMA_DECODER_YOLOV5, &self->out, 1, &params,
+      self->results);
+  gst_sscma_nms (self->results, prop->threshold[1]);
+  stage = (guint32) ((g_get_monotonic_time () - start) / 1000);
+  g_array_append_val (self->infer_time, stage);
+
+  if (output_json) {
+    *outbuf = gst_sscma_json_buffer (buf, &frame.map[0], self->results,
+        self->infer_time);
+    gst_video_frame_unmap (&frame);
+    gst_buffer_unref (buf);
+  } else {
+    gst_sscma_draw (&image, prop->labels, prop->total_labels, self->results);
+    gst_video_frame_unmap (&frame);
+    *outbuf = buf;
+  }
+
+  return GST_FLOW_OK;
+}
+
+/**
+ * @brief Update the inferred counter and the fps of a stream. Must be called with the lock held.
+ */
+static void
+gst_sscma_yolov5_multi_update_stats (GstSscmaYolov5MultiStream * stream)
+{
+  const gint64 now = g_get_monotonic_time ();
+
+  stream->inferred++;
+  stream->fps_count++;
+  if (stream->fps_start == 0) {
+    stream->fps_start = now;
+    stream->fps_count = 0;
+  } else if (now - stream->fps_start >= G_USEC_PER_SEC) {
+    stream->fps = stream->fps_count * (gdouble) G_USEC_PER_SEC
+        / (now - stream->fps_start);
+    stream->fps_start = now;
+    stream->fps_count = 0;
+  }
+}
+
+/**
+ * @brief Inference thread: serves the stream the scheduler picks, one frame at a time.
+ */
+static gpointer
+gst_sscma_yolov5_multi_worker (gpointer data)
+{
+  GstSscmaYolov5Multi *self = GST_SSCMA_YOLOV5_MULTI (data);
+  GstSscmaYolov5MultiStream *stream;
+  GstBuffer *buf, *outbuf;
+  GstFlowReturn ret;
+
+  g_mutex_lock (&self->lock);
+  while (!self->worker_stop) {
+    stream = gst_sscma_yolov5_multi_schedule (self);
+    if (stream == NULL) {
+      g_cond_wait (&self->cond, &self->lock);
+      continue;
+    }
+
+    buf = stream->pending;
+    stream->pending = NULL;
+    stream->busy = TRUE;
+    g_mutex_unlock (&self->lock);
+
+    outbuf = NULL;
+    ret = gst_sscma_yolov5_multi_process (self, stream, buf, &outbuf);
+    if (ret == GST_FLOW_OK)
+      ret = gst_pad_push (stream->srcpad, outbuf);
+    else
+      GST_ELEMENT_ERROR (self, STREAM, FAILED,
+          ("Failed to process a frame of %s", GST_PAD_NAME (stream->sinkpad)),
+          (NULL));
+
+    g_mutex_lock (&self->lock);
+    stream->busy = FALSE;
+    if (ret == GST_FLOW_OK)
+      gst_sscma_yolov5_multi_update_stats (stream);
+    else if (!stream->flushing)
+      stream->last_flow = ret;
+    g_cond_broadcast (&self->cond);
+  }
+  g_mutex_unlock (&self->lock);
+
+  return NULL;
+}
+
+/**
+ * @brief Load the model and start the inference thread with the streaming state.
+ */
+static gboolean
+gst_sscma_yolov5_multi_start (GstSscmaYolov5Multi * self)
+{
+  GstSscmaYolov5Properties *prop = &self->prop;
+  GstSscmaModel *model;
+
+  if (prop->num_models < 2) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND,
+        ("No model configured, please set the model property."), (NULL));
+    return FALSE;
+  }
+
+  model = gst_sscma_model_cache_acquire (prop->model_files[1],
+      prop->model_files[0], prop->opt, prop->use_mmap);
+  if (model == NULL) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND,
+        ("Failed to load model %s", prop->model_files[1]), (NULL));
+    return FALSE;
+  }
+  if (self->model)
+    gst_sscma_model_unref (self->model);
+  self->model = model;
+
+  gst_sscma_yolov5_multi_context_init (self);
+
+  g_mutex_lock (&self->lock);
+  self->worker_stop = FALSE;
+  self->cursor = 0;
+  self->worker = g_thread_new ("sscma-multi", gst_sscma_yolov5_multi_worker,
+      self);
+  g_mutex_unlock (&self->lock);
+
+  return TRUE;
+}
+
+/**
+ * @brief Stop the inference thread and drop the frames it did not handle yet.
+ */
+static void
+gst_sscma_yolov5_multi_stop (GstSscmaYolov5Multi * self)
+{
+  GThread *worker;
+  guint i;
+
+  g_mutex_lock (&self->lock);
+  self->worker_stop = TRUE;
+  worker = self->worker;
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->lock);
+
+  if (worker)
+    g_thread_join (worker);
+
+  g_mutex_lock (&self->lock);
+  self->worker = NULL;
+  for (i = 0; i < self->streams->len; i++) {
+    GstSscmaYolov5MultiStream *stream =
+        (GstSscmaYolov5MultiStream *) g_ptr_array_index (self->streams, i);
+    gst_clear_buffer (&stream->pending);
+    stream->last_flow = GST_FLOW_OK;
+  }
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->lock);
+
+  gst_sscma_yolov5_multi_context_clear (self);
+}
+
+static GstStateChangeReturn
+gst_sscma_yolov5_multi_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstSscmaYolov5Multi *self = GST_SSCMA_YOLOV5_MULTI (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (!gst_sscma_yolov5_multi_start (self))
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* the sink pads are deactivated and downstream is in READY, so no
+       * chain runs any more and the thread cannot block in a push */
+      gst_sscma_yolov5_multi_stop (self);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
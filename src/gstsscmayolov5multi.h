@@ -0,0 +1,103 @@
+#ifndef __GST_SSCMAYOLOV5MULTI_H__
+#define __GST_SSCMAYOLOV5MULTI_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include "gstsscmayolov5.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_SSCMAYOLOV5MULTI \
+  (gst_sscma_yolov5_multi_get_type())
+#define GST_SSCMA_YOLOV5_MULTI(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_SSCMAYOLOV5MULTI,GstSscmaYolov5Multi))
+#define GST_SSCMA_YOLOV5_MULTI_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_SSCMAYOLOV5MULTI,GstSscmaYolov5MultiClass))
+#define GST_IS_SSCMA_YOLOV5_MULTI(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_SSCMAYOLOV5MULTI))
+
+/**
+ * @brief How the inference thread picks the next stream to serve.
+ */
+typedef enum
+{
+  GST_SSCMA_YOLOV5_MULTI_ROUND_ROBIN = 0, /**< streams with a frame waiting take turns */
+  GST_SSCMA_YOLOV5_MULTI_DEADLINE, /**< the frame whose next one is due first goes first */
+} GstSscmaYolov5MultiSchedule;
+
+#define GST_TYPE_SSCMAYOLOV5_MULTI_SCHEDULE \
+  (gst_sscma_yolov5_multi_schedule_get_type())
+GType gst_sscma_yolov5_multi_schedule_get_type (void);
+
+typedef struct _GstSscmaYolov5Multi GstSscmaYolov5Multi;
+typedef struct _GstSscmaYolov5MultiClass GstSscmaYolov5MultiClass;
+
+/**
+ * @brief One camera stream: a sink_%u request pad and its src_%u pad.
+ *
+ * Only the newest frame of a stream waits for inference, an older one still
+ * waiting is dropped when a new one arrives.
+ */
+typedef struct _GstSscmaYolov5MultiStream
+{
+  guint index; /**< N of sink_N / src_N */
+  GstPad *sinkpad;
+  GstPad *srcpad;
+
+  /* all fields below are protected by the element's lock */
+  GstVideoInfo vinfo; /**< negotiated input format */
+  gboolean output_json; /**< TRUE if src_N outputs text/x-json instead of video */
+  GstBuffer *pending; /**< newest frame not inferred yet */
+  gint64 deadline; /**< monotonic time (us) the next frame of the stream is due */
+  gboolean busy; /**< TRUE while the inference thread handles a frame of this stream */
+  gboolean flushing; /**< TRUE between FLUSH_START and FLUSH_STOP */
+  GstFlowReturn last_flow; /**< last flow return of src_N */
+
+  guint64 frames; /**< frames received */
+  guint64 inferred; /**< frames inferred and pushed */
+  guint64 dropped; /**< frames replaced by a newer one before being inferred */
+  gdouble fps; /**< inferences per second over the last second */
+  gint64 fps_start; /**< start of the current fps window */
+  guint fps_count; /**< inferences in the current fps window */
+
+  GstSscmaResizeTable resize; /**< sampling positions, used by the inference thread while busy */
+} GstSscmaYolov5MultiStream;
+
+struct _GstSscmaYolov5MultiClass
+{
+  GstElementClass parent_class;   /**< Inherits GstElementClass */
+};
+
+struct _GstSscmaYolov5Multi
+{
+  GstElement element;
+
+  GstSscmaYolov5Properties prop; /**< model, labels, input size and thresholds */
+  GstSscmaYolov5MultiSchedule schedule; /**< stream scheduling policy */
+  GstSscmaModel *model; /**< shared, refcounted network, set between READY and PAUSED */
+
+  /* inference state, used by the inference thread only */
+  ncnn::UnlockedPoolAllocator *blob_pool;
+  ncnn::PoolAllocator *workspace_pool;
+  ncnn::Extractor *ex; /**< reused across frames of every stream */
+  ncnn::Mat in;
+  ncnn::Mat out;
+  GArray *results; /**< detectedObject array reused across frames */
+  GArray *infer_time; /**< guint32 per-stage times reused across frames */
+
+  GMutex lock;
+  GCond cond;
+  GPtrArray *streams; /**< GstSscmaYolov5MultiStream, in request order */
+  guint next_index; /**< index of the next sink_%u pad */
+  guint cursor; /**< round robin: position the next search starts at */
+  GThread *worker; /**< inference thread */
+  gboolean worker_stop; /**< TRUE to make the inference thread exit */
+};
+
+GType gst_sscma_yolov5_multi_get_type (void);
+
+GST_ELEMENT_REGISTER_DECLARE (sscma_yolov5_multi);
+
+G_END_DECLS
+
+#endif /* __GST_SSCMAYOLOV5MULTI_H__ */
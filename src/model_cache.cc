@@ -0,0 +1,369 @@
+#include <string.h>
+#include <glib/gstdio.h>
+#include <datareader.h>
+#include <layer.h>
+#include "model_cache.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_sscma_model_cache_debug);
+#define GST_CAT_DEFAULT gst_sscma_model_cache_debug
+
+/** @brief Process-wide cache, key -> GstSscmaModel. Entries do not hold a reference. */
+static GHashTable *model_cache = NULL;
+static GMutex model_cache_lock;
+
+/**
+ * @brief Build the cache key of a param/bin pair loaded with the given options.
+ * @return newly allocated key, NULL if one of the files cannot be stat'ed
+ *
+ * The options a net was loaded with change the layers ncnn creates and how it
+ * packs the weights, and use_mmap where the weights live, so elements tuned
+ * differently never share a net.
+ */
+static gchar *
+gst_sscma_model_cache_key (const gchar * param_path, const gchar * bin_path,
+    const ncnn::Option & opt, gboolean use_mmap)
+{
+  GStatBuf param_stat, bin_stat;
+
+  if (g_stat (param_path, &param_stat) != 0) {
+    GST_ERROR ("Cannot stat model param file %s", param_path);
+    return NULL;
+  }
+  if (g_stat (bin_path, &bin_stat) != 0) {
+    GST_ERROR ("Cannot stat model bin file %s", bin_path);
+    return NULL;
+  }
+
+  return g_strdup_printf ("%s:%" G_GINT64_FORMAT "|%s:%" G_GINT64_FORMAT
+      "|fp16s%d fp16a%d bf16s%d pack%d wino%d sgemm%d light%d mmap%d",
+      param_path, (gint64) param_stat.st_mtime,
+      bin_path, (gint64) bin_stat.st_mtime,
+      opt.use_fp16_storage, opt.use_fp16_arithmetic, opt.use_bf16_storage,
+      opt.use_packing_layout, opt.use_winograd_convolution,
+      opt.use_sgemm_convolution, opt.lightmode, use_mmap ? 1 : 0);
+}
+
+/**
+ * @brief Read the anonymous and file backed resident memory of the process.
+ *
+ * Heap copies of the weights show up in RssAnon, mapped weights in RssFile,
+ * where their pages are shared with every other process mapping the file.
+ */
+static void
+gst_sscma_model_get_rss (guint64 * anon_kb, guint64 * file_kb)
+{
+  gchar *contents = NULL;
+  gchar **lines;
+  guint i;
+
+  *anon_kb = *file_kb = 0;
+  if (!g_file_get_contents ("/proc/self/status", &contents, NULL, NULL))
+    return;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++) {
+    if (g_str_has_prefix (lines[i], "RssAnon:"))
+      *anon_kb = g_ascii_strtoull (lines[i] + strlen ("RssAnon:"), NULL, 10);
+    else if (g_str_has_prefix (lines[i], "RssFile:"))
+      *file_kb = g_ascii_strtoull (lines[i] + strlen ("RssFile:"), NULL, 10);
+  }
+  g_strfreev (lines);
+  g_free (contents);
+}
+
+/**
+ * @brief Map a model file, copy on write in case a layer touches its weights.
+ */
+static GMappedFile *
+gst_sscma_model_map (const gchar * path)
+{
+  GMappedFile *map;
+  GError *err = NULL;
+
+  map = g_mapped_file_new (path, TRUE, &err);
+  if (map == NULL) {
+    GST_ERROR ("Cannot map %s: %s", path, err->message);
+    g_clear_error (&err);
+  }
+  return map;
+}
+
+/**
+ * @brief Load the param and bin files into model->net.
+ * @return TRUE on success
+ *
+ * A ".param.bin" param file is the binary form written by ncnn2mem, it has no
+ * blob names so the input and output blobs are taken from the graph. With
+ * use_mmap, both files are mapped and ncnn references the weights in place
+ * instead of reading them into heap memory.
+ */
+static gboolean
+gst_sscma_model_load (GstSscmaModel * model, const gchar * param_path,
+    const gchar * bin_path, gboolean use_mmap)
+{
+  const gboolean binary_param = g_str_has_suffix (param_path, ".param.bin");
+  const unsigned char *mem;
+  int ret;
+
+  model->input_index = -1;
+  model->output_index = -1;
+
+  if (use_mmap && binary_param) {
+    model->param_map = gst_sscma_model_map (param_path);
+    if (model->param_map == NULL)
+      return FALSE;
+    mem = (const unsigned char *) g_mapped_file_get_contents (model->param_map);
+    ncnn::DataReaderFromMemory dr (mem);
+    ret = model->net.load_param_bin (dr);
+  } else if (binary_param) {
+    ret = model->net.load_param_bin (param_path);
+  } else {
+    /* text params are parsed into the layers anyway, mapping them gains nothing */
+    ret = model->net.load_param (param_path);
+  }
+  if (ret != 0)
+    return FALSE;
+
+  if (use_mmap) {
+    model->bin_map = gst_sscma_model_map (bin_path);
+    if (model->bin_map == NULL)
+      return FALSE;
+    mem = (const unsigned char *) g_mapped_file_get_contents (model->bin_map);
+    ncnn::DataReaderFromMemory dr (mem);
+    ret = model->net.load_model (dr);
+  } else {
+    ret = model->net.load_model (bin_path);
+  }
+  if (ret != 0)
+    return FALSE;
+
+  if (binary_param) {
+    if (model->net.input_indexes ().empty ()
+        || model->net.output_indexes ().empty ()) {
+      GST_ERROR ("Model %s has no input or output blob", param_path);
+      return FALSE;
+    }
+    model->input_index = model->net.input_indexes ()[0];
+    model->output_index = model->net.output_indexes ()[0];
+  }
+
+  return TRUE;
+}
+
+/**
+ * @brief Free a model that is not, or no longer, in the cache.
+ */
+static void
+gst_sscma_model_free (GstSscmaModel * model)
+{
+  /* the net may point into the mapped weights, release it first */
+  model->net.clear ();
+  if (model->bin_map)
+    g_mapped_file_unref (model->bin_map);
+  if (model->param_map)
+    g_mapped_file_unref (model->param_map);
+  g_free (model->key);
+  delete model;
+}
+
+/**
+ * @brief Take a reference on a cached model unless it is already being destroyed.
+ */
+static gboolean
+gst_sscma_model_try_ref (GstSscmaModel * model)
+{
+  gint old;
+
+  do {
+    old = g_atomic_int_get (&model->refcount);
+    if (old == 0)
+      return FALSE;
+  } while (!g_atomic_int_compare_and_exchange (&model->refcount, old, old + 1));
+
+  return TRUE;
+}
+
+/**
+ * @brief Look up a model in the cache, the caller must hold model_cache_lock.
+ */
+static GstSscmaModel *
+gst_sscma_model_cache_lookup (const gchar * key)
+{
+  GstSscmaModel *model;
+
+  model = (GstSscmaModel *) g_hash_table_lookup (model_cache, key);
+  if (model && gst_sscma_model_try_ref (model))
+    return model;
+
+  return NULL;
+}
+
+/**
+ * @brief Get the network for the given param/bin pair, loading it if needed.
+ * @param param_path path to the ncnn param file
+ * @param bin_path path to the ncnn bin file
+ * @param opt options applied to the net before its param file is loaded
+ * @param use_mmap TRUE to use the weights in place from a mapping of bin_path
+ * @return a new reference to the model, NULL on failure
+ *
+ * Loading happens without holding the cache lock so that a slow load never
+ * stalls elements releasing or looking up other models.
+ */
+GstSscmaModel *
+gst_sscma_model_cache_acquire (const gchar * param_path, const gchar * bin_path,
+    const ncnn::Option & opt, gboolean use_mmap)
+{
+  GstSscmaModel *model, *cached;
+  guint64 anon_before, file_before, anon_after, file_after;
+  gint64 start;
+  gchar *key;
+
+  g_return_val_if_fail (param_path != NULL, NULL);
+  g_return_val_if_fail (bin_path != NULL, NULL);
+
+  g_mutex_lock (&model_cache_lock);
+  if (model_cache == NULL) {
+    GST_DEBUG_CATEGORY_INIT (gst_sscma_model_cache_debug, "sscmamodelcache",
+        0, "sscma shared model cache");
+    model_cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, NULL);
+  }
+  g_mutex_unlock (&model_cache_lock);
+
+  key = gst_sscma_model_cache_key (param_path, bin_path, opt, use_mmap);
+  if (key == NULL)
+    return NULL;
+
+  g_mutex_lock (&model_cache_lock);
+  model = gst_sscma_model_cache_lookup (key);
+  g_mutex_unlock (&model_cache_lock);
+  if (model) {
+    GST_DEBUG ("Sharing cached model %s", key);
+    g_free (key);
+    return model;
+  }
+
+  model = new GstSscmaModel ();
+  model->refcount = 1;
+  model->key = key;
+  model->net.opt = opt;
+
+  gst_sscma_model_get_rss (&anon_before, &file_before);
+  start = g_get_monotonic_time ();
+  if (!gst_sscma_model_load (model, param_path, bin_path, use_mmap)) {
+    GST_ERROR ("Failed to load model %s / %s", param_path, bin_path);
+    gst_sscma_model_free (model);
+    return NULL;
+  }
+  gst_sscma_model_get_rss (&anon_after, &file_after);
+  GST_INFO ("Loaded model %s%s in %.2f ms, RssAnon %" G_GUINT64_FORMAT
+      " -> %" G_GUINT64_FORMAT " kB, RssFile %" G_GUINT64_FORMAT " -> %"
+      G_GUINT64_FORMAT " kB", bin_path, use_mmap ? " (mmap)" : "",
+      (g_get_monotonic_time () - start) / 1000.0, anon_before, anon_after,
+      file_before, file_after);
+
+  g_mutex_lock (&model_cache_lock);
+  cached = gst_sscma_model_cache_lookup (key);
+  if (cached == NULL)
+    g_hash_table_replace (model_cache, model->key, model);
+  g_mutex_unlock (&model_cache_lock);
+
+  if (cached) {
+    /* somebody else loaded the same files meanwhile, keep a single copy */
+    gst_sscma_model_free (model);
+    return cached;
+  }
+
+  return model;
+}
+
+/**
+ * @brief Increase the reference count of a model.
+ */
+GstSscmaModel *
+gst_sscma_model_ref (GstSscmaModel * model)
+{
+  g_return_val_if_fail (model != NULL, NULL);
+
+  g_atomic_int_inc (&model->refcount);
+  return model;
+}
+
+/**
+ * @brief Drop a reference, the last one removes the model from the cache and frees it.
+ */
+void
+gst_sscma_model_unref (GstSscmaModel * model)
+{
+  g_return_if_fail (model != NULL);
+
+  if (!g_atomic_int_dec_and_test (&model->refcount))
+    return;
+
+  g_mutex_lock (&model_cache_lock);
+  if (g_hash_table_lookup (model_cache, model->key) == model)
+    g_hash_table_remove (model_cache, model->key);
+  g_mutex_unlock (&model_cache_lock);
+
+  GST_DEBUG ("Releasing model %s", model->key);
+  gst_sscma_model_free (model);
+}
+
+/**
+ * @brief Check that every entry of an ncnn int8 calibration table names a layer of the model.
+ * @param table_path table in the ncnn2table format: "<layer>_param_0 <scales...>"
+ *        lines for weights and "<layer> <scale>" lines for bottom blobs
+ * @return FALSE if the table cannot be read or refers to unknown layers
+ */
+gboolean
+gst_sscma_model_check_int8_table (GstSscmaModel * model, const gchar * table_path)
+{
+  const std::vector<ncnn::Layer *> &layers = model->net.layers ();
+  GHashTable *names;
+  gchar *contents = NULL;
+  gchar **lines;
+  GError *err = NULL;
+  gboolean ok = TRUE;
+  guint i, entries = 0;
+
+  if (!g_file_get_contents (table_path, &contents, NULL, &err)) {
+    GST_ERROR ("Unable to read calibration table %s: %s", table_path,
+        err->message);
+    g_clear_error (&err);
+    return FALSE;
+  }
+
+  names = g_hash_table_new (g_str_hash, g_str_equal);
+  for (i = 0; i < layers.size (); i++)
+    g_hash_table_add (names, (gpointer) layers[i]->name.c_str ());
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++) {
+    gchar *name = g_strstrip (lines[i]);
+    gchar *end, *param;
+
+    if (name[0] == '\0')
+      continue;
+    end = strchr (name, ' ');
+    if (end)
+      *end = '\0';
+    param = g_strrstr (name, "_param_");
+    if (param)
+      *param = '\0';
+
+    entries++;
+    if (!g_hash_table_contains (names, name)) {
+      GST_WARNING ("Calibration table entry %s has no matching layer", name);
+      ok = FALSE;
+    }
+  }
+
+  if (entries == 0) {
+    GST_ERROR ("Calibration table %s is empty", table_path);
+    ok = FALSE;
+  }
+
+  g_strfreev (lines);
+  g_hash_table_destroy (names);
+  g_free (contents);
+  return ok;
+}
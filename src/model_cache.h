@@ -0,0 +1,31 @@
+#ifndef __GST_SSCMA_MODEL_CACHE_H__
+#define __GST_SSCMA_MODEL_CACHE_H__
+
+#include <gst/gst.h>
+#include <net.h>
+
+/**
+ * @brief A loaded network, shared by every element that uses the same model files.
+ *
+ * The net is immutable once it has been published in the cache: elements only
+ * call create_extractor () on it, which ncnn allows from several threads at once.
+ */
+typedef struct _GstSscmaModel
+{
+  gint refcount; /**< atomic, the entry leaves the cache when it drops to 0 */
+  gchar *key; /**< cache key: param/bin paths, their mtimes and the net options */
+  GMappedFile *param_map; /**< mapped .param.bin, NULL unless loaded with mmap */
+  GMappedFile *bin_map; /**< mapped weights the net uses in place, NULL unless loaded with mmap */
+  int input_index; /**< input blob of a .param.bin model, -1 to look blobs up by name */
+  int output_index; /**< output blob of a .param.bin model, -1 to look blobs up by name */
+  ncnn::Net net; /**< NNFW's net object */
+} GstSscmaModel;
+
+GstSscmaModel * gst_sscma_model_cache_acquire (const gchar * param_path,
+    const gchar * bin_path, const ncnn::Option & opt, gboolean use_mmap);
+GstSscmaModel * gst_sscma_model_ref (GstSscmaModel * model);
+void gst_sscma_model_unref (GstSscmaModel * model);
+gboolean gst_sscma_model_check_int8_table (GstSscmaModel * model,
+    const gchar * table_path);
+
+#endif /* __GST_SSCMA_MODEL_CACHE_H__ */
@@ -0,0 +1,102 @@
+#include "motion.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Sample a frame into a GST_SSCMA_MOTION_WIDTH x GST_SSCMA_MOTION_HEIGHT luma thumbnail.
+ *
+ * Each thumbnail pixel is the BT.601 luma of the 2x2 block at the center of
+ * its cell, enough to see motion without touching most of the frame. YUV
+ * frames give their luma plane as is.
+ */
+void
+gst_sscma_motion_thumbnail (const GstSscmaImage * image, guint8 * thumbnail)
+{
+  const int width = image->width, height = image->height;
+  const int stride = image->strides[0];
+  const int bpp = gst_sscma_pixel_stride (image->format);
+  const int red = gst_sscma_pixel_red_offset (image->format);
+  int x, y;
+
+  for (y = 0; y < GST_SSCMA_MOTION_HEIGHT; y++) {
+    const int sy = MIN ((2 * y + 1) * height / (2 * GST_SSCMA_MOTION_HEIGHT),
+        height - 2);
+    const guint8 *row0 = image->planes[0] + MAX (sy, 0) * stride;
+    const guint8 *row1 = height > 1 ? row0 + stride : row0;
+
+    for (x = 0; x < GST_SSCMA_MOTION_WIDTH; x++) {
+      const int sx = MAX (0, MIN ((2 * x + 1) * width
+              / (2 * GST_SSCMA_MOTION_WIDTH), width - 2));
+      const int dx = width > 1 ? bpp : 0;
+      const guint8 *p00 = row0 + sx * bpp, *p01 = p00 + dx;
+      const guint8 *p10 = row1 + sx * bpp, *p11 = p10 + dx;
+
+      if (red < 0) {
+        thumbnail[y * GST_SSCMA_MOTION_WIDTH + x] =
+            (guint8) ((p00[0] + p01[0] + p10[0] + p11[0]) >> 2);
+      } else {
+        const guint r = p00[red] + p01[red] + p10[red] + p11[red];
+        const guint g = p00[1] + p01[1] + p10[1] + p11[1];
+        const guint b = p00[2 - red] + p01[2 - red] + p10[2 - red]
+            + p11[2 - red];
+
+        /* 77, 150, 29 are the BT.601 weights in 1/256, the sums are 4x */
+        thumbnail[y * GST_SSCMA_MOTION_WIDTH + x] =
+            (guint8) ((77 * r + 150 * g + 29 * b) >> 10);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Count the pixels whose absolute difference exceeds threshold.
+ */
+guint
+gst_sscma_motion_changed (const guint8 * a, const guint8 * b, guint size,
+    guint8 threshold)
+{
+  guint changed = 0;
+  guint i = 0;
+
+#if defined(__ARM_NEON)
+  const uint8x16_t thr = vdupq_n_u8 (threshold);
+  const uint8x16_t one = vdupq_n_u8 (1);
+
+  /* 255 blocks at most before the 8-bit lane counters could wrap */
+  while (i + 16 <= size) {
+    uint8x16_t count = vdupq_n_u8 (0);
+    guint blocks = 0;
+
+    for (; i + 16 <= size && blocks < 255; i += 16, blocks++) {
+      uint8x16_t diff = vabdq_u8 (vld1q_u8 (a + i), vld1q_u8 (b + i));
+      count = vaddq_u8 (count, vandq_u8 (vcgtq_u8 (diff, thr), one));
+    }
+    uint64x2_t sum = vpaddlq_u32 (vpaddlq_u16 (vpaddlq_u8 (count)));
+    changed += (guint) (vgetq_lane_u64 (sum, 0) + vgetq_lane_u64 (sum, 1));
+  }
+#elif defined(__SSE2__)
+  const __m128i thr = _mm_set1_epi8 ((char) threshold);
+  const __m128i zero = _mm_setzero_si128 ();
+
+  for (; i + 16 <= size; i += 16) {
+    __m128i va = _mm_loadu_si128 ((const __m128i *) (a + i));
+    __m128i vb = _mm_loadu_si128 ((const __m128i *) (b + i));
+    __m128i diff = _mm_or_si128 (_mm_subs_epu8 (va, vb), _mm_subs_epu8 (vb, va));
+    /* lanes at or below the threshold saturate to zero */
+    __m128i over = _mm_cmpeq_epi8 (_mm_subs_epu8 (diff, thr), zero);
+
+    changed += 16 - __builtin_popcount (_mm_movemask_epi8 (over));
+  }
+#endif
+
+  for (; i < size; i++) {
+    if ((guint8) ABS (a[i] - b[i]) > threshold)
+      changed++;
+  }
+
+  return changed;
+}
@@ -0,0 +1,17 @@
+#ifndef __GST_SSCMA_MOTION_H__
+#define __GST_SSCMA_MOTION_H__
+
+#include <glib.h>
+#include "preprocess.h"
+
+/** @brief Size of the luma thumbnail frames are compared on */
+#define GST_SSCMA_MOTION_WIDTH 80
+#define GST_SSCMA_MOTION_HEIGHT 45
+#define GST_SSCMA_MOTION_SIZE (GST_SSCMA_MOTION_WIDTH * GST_SSCMA_MOTION_HEIGHT)
+
+void gst_sscma_motion_thumbnail (const GstSscmaImage * image,
+    guint8 * thumbnail);
+guint gst_sscma_motion_changed (const guint8 * a, const guint8 * b, guint size,
+    guint8 threshold);
+
+#endif /* __GST_SSCMA_MOTION_H__ */
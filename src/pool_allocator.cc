@@ -0,0 +1,92 @@
+#include "pool_allocator.h"
+
+/** @brief A heap block owned by the pool */
+typedef struct
+{
+  size_t size;
+  void *ptr;
+} GstSscmaPoolBlock;
+
+GstSscmaCountingAllocator::GstSscmaCountingAllocator (gboolean locked)
+  : allocations (0), locked (locked), budgets (NULL), payouts (NULL)
+{
+  g_mutex_init (&lock);
+}
+
+GstSscmaCountingAllocator::~GstSscmaCountingAllocator ()
+{
+  GList *l;
+
+  if (payouts)
+    g_warning ("pool allocator destroyed with %u blocks still in use",
+        g_list_length (payouts));
+
+  for (l = budgets; l; l = l->next) {
+    ncnn::fastFree (((GstSscmaPoolBlock *) l->data)->ptr);
+    g_free (l->data);
+  }
+  for (l = payouts; l; l = l->next) {
+    ncnn::fastFree (((GstSscmaPoolBlock *) l->data)->ptr);
+    g_free (l->data);
+  }
+  g_list_free (budgets);
+  g_list_free (payouts);
+  g_mutex_clear (&lock);
+}
+
+void *
+GstSscmaCountingAllocator::fastMalloc (size_t size)
+{
+  GstSscmaPoolBlock *block;
+  GList *l;
+
+  if (locked)
+    g_mutex_lock (&lock);
+
+  /* a kept block of at least size, wasting at most a quarter of it */
+  for (l = budgets; l; l = l->next) {
+    block = (GstSscmaPoolBlock *) l->data;
+    if (block->size >= size && block->size / 4 * 3 <= size) {
+      budgets = g_list_remove_link (budgets, l);
+      payouts = g_list_concat (l, payouts);
+      if (locked)
+        g_mutex_unlock (&lock);
+      return block->ptr;
+    }
+  }
+
+  block = g_new (GstSscmaPoolBlock, 1);
+  block->size = size;
+  block->ptr = ncnn::fastMalloc (size);
+  payouts = g_list_prepend (payouts, block);
+  g_atomic_int_inc (&allocations);
+
+  if (locked)
+    g_mutex_unlock (&lock);
+
+  return block->ptr;
+}
+
+void
+GstSscmaCountingAllocator::fastFree (void *ptr)
+{
+  GList *l;
+
+  if (locked)
+    g_mutex_lock (&lock);
+
+  for (l = payouts; l; l = l->next) {
+    if (((GstSscmaPoolBlock *) l->data)->ptr == ptr) {
+      payouts = g_list_remove_link (payouts, l);
+      budgets = g_list_concat (l, budgets);
+      break;
+    }
+  }
+
+  if (locked)
+    g_mutex_unlock (&lock);
+
+  /* not from this pool */
+  if (l == NULL)
+    ncnn::fastFree (ptr);
+}
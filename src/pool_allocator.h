@@ -0,0 +1,34 @@
+#ifndef __GST_SSCMA_POOL_ALLOCATOR_H__
+#define __GST_SSCMA_POOL_ALLOCATOR_H__
+
+#include <glib.h>
+#include <allocator.h>
+
+/**
+ * @brief ncnn pool allocator that counts the heap allocations it makes.
+ *
+ * Freed blocks are kept and handed back for requests of a close size, as
+ * ncnn::PoolAllocator does. Only a request no kept block can serve reaches
+ * the heap and bumps the counter, so once the pool is warm the counter stays
+ * still, which is how a frame is shown to run without heap allocations.
+ */
+class GstSscmaCountingAllocator : public ncnn::Allocator
+{
+public:
+  /** @param locked TRUE if several threads allocate from it (layer workspace) */
+  GstSscmaCountingAllocator (gboolean locked);
+  virtual ~GstSscmaCountingAllocator ();
+
+  virtual void *fastMalloc (size_t size);
+  virtual void fastFree (void *ptr);
+
+  guint allocations; /**< atomic, heap allocations since the counter was last reset */
+
+private:
+  gboolean locked;
+  GMutex lock; /**< protects budgets and payouts if locked */
+  GList *budgets; /**< free blocks, GstSscmaPoolBlock */
+  GList *payouts; /**< blocks handed out, GstSscmaPoolBlock */
+};
+
+#endif /* __GST_SSCMA_POOL_ALLOCATOR_H__ */
@@ -0,0 +1,834 @@
+#include <math.h>
+#include <string.h>
+#include <json-glib/json-glib.h>
+#include "postprocess.h"
+#include "tensor_info.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Load a labels file, one class name per line.
+ * @return new labels with a refcount of 1, NULL with error set if the file cannot be read
+ */
+GstSscmaLabels *
+gst_sscma_labels_new_from_file (const gchar * path, GError ** error)
+{
+  GstSscmaLabels *labels;
+  gchar *contents = NULL;
+  gsize len;
+  guint i;
+
+  if (!g_file_get_contents (path, &contents, &len, error))
+    return NULL;
+
+  if (len > 0 && contents[len - 1] == '\n')
+    contents[len - 1] = '\0';
+
+  labels = g_new0 (GstSscmaLabels, 1);
+  labels->refcount = 1;
+  labels->names = g_strsplit (contents, "\n", -1);
+  labels->count = g_strv_length (labels->names);
+  for (i = 0; i < labels->count; i++)
+    labels->max_word_length = MAX (labels->max_word_length,
+        (guint) strlen (labels->names[i]));
+  g_free (contents);
+
+  return labels;
+}
+
+/**
+ * @brief Take a reference on labels.
+ */
+GstSscmaLabels *
+gst_sscma_labels_ref (GstSscmaLabels * labels)
+{
+  g_return_val_if_fail (labels != NULL, NULL);
+
+  g_atomic_int_inc (&labels->refcount);
+  return labels;
+}
+
+/**
+ * @brief Drop a reference on labels, the last one frees them.
+ */
+void
+gst_sscma_labels_unref (GstSscmaLabels * labels)
+{
+  g_return_if_fail (labels != NULL);
+
+  if (!g_atomic_int_dec_and_test (&labels->refcount))
+    return;
+
+  g_strfreev (labels->names);
+  g_free (labels);
+}
+
+/**
+ * @brief Project a box of the model input back into the source frame.
+ * @param box cx, cy, w, h in model input pixels, or normalized if !is_output_scaled
+ * @param score best class score, prob is score * objectness
+ */
+static inline void
+gst_sscma_project_box (const float *box, int class_id, gfloat score,
+    gfloat prob, gboolean is_output_scaled, const GstSscmaDecodeParams * params,
+    detectedObject * object)
+{
+  const GstSscmaInputTransform *transform = params->transform;
+  float cx, cy, w, h, x1, y1, x2, y2;
+
+  cx = box[0];
+  cy = box[1];
+  w = box[2];
+  h = box[3];
+
+  // Unscaled outputs are normalized to the model input
+  if (!is_output_scaled) {
+    cx *= (float) transform->width;
+    cy *= (float) transform->height;
+    w *= (float) transform->width;
+    h *= (float) transform->height;
+  }
+
+  // Project the box back from the model input into the source frame
+  x1 = (cx - w / 2.f - transform->pad_left) / transform->scale_x;
+  y1 = (cy - h / 2.f - transform->pad_top) / transform->scale_y;
+  x2 = (cx + w / 2.f - transform->pad_left) / transform->scale_x;
+  y2 = (cy + h / 2.f - transform->pad_top) / transform->scale_y;
+  x1 = CLAMP (x1, 0.f, (float) (params->width - 1));
+  y1 = CLAMP (y1, 0.f, (float) (params->height - 1));
+  x2 = CLAMP (x2, 0.f, (float) (params->width - 1));
+  y2 = CLAMP (y2, 0.f, (float) (params->height - 1));
+
+  object->x = (int) (x1 + 0.5f);
+  object->y = (int) (y1 + 0.5f);
+  object->width = (int) (x2 + 0.5f) - object->x;
+  object->height = (int) (y2 + 0.5f) - object->y;
+
+  object->prob = prob;
+  object->class_id = class_id;
+  object->tracking_id = int(score);
+  object->valid = TRUE;
+}
+
+/**
+ * @brief Project a box of the model input back into the source frame and append it.
+ */
+static inline void
+gst_sscma_append_box (const float *box, int class_id, gfloat score,
+    gfloat prob, gboolean is_output_scaled, const GstSscmaDecodeParams * params,
+    GArray * results)
+{
+  detectedObject object;
+
+  gst_sscma_project_box (box, class_id, score, prob, is_output_scaled, params,
+      &object);
+  g_array_append_val (results, object);
+}
+
+/**
+ * @brief Largest of n scores, 0 if they are all negative. NaN scores are ignored.
+ *
+ * The SIMD paths keep a lane only if the new score compares greater, as the
+ * scalar loop does, so a NaN never becomes the maximum.
+ */
+static inline float
+gst_sscma_max_score (const float *scores, int n)
+{
+  float max_val = 0.f;
+  int c = 0;
+
+#if defined(__ARM_NEON)
+  if (n >= 4) {
+    float32x4_t vmax = vdupq_n_f32 (0.f);
+    float32x2_t half;
+
+    for (; c + 4 <= n; c += 4) {
+      const float32x4_t v = vld1q_f32 (scores + c);
+      vmax = vbslq_f32 (vcgtq_f32 (v, vmax), v, vmax);
+    }
+    half = vpmax_f32 (vget_low_f32 (vmax), vget_high_f32 (vmax));
+    max_val = vget_lane_f32 (vpmax_f32 (half, half), 0);
+  }
+#elif defined(__SSE2__)
+  if (n >= 4) {
+    __m128 vmax = _mm_setzero_ps ();
+
+    /* maxps returns its second operand when one is NaN */
+    for (; c + 4 <= n; c += 4)
+      vmax = _mm_max_ps (_mm_loadu_ps (scores + c), vmax);
+    vmax = _mm_max_ps (vmax, _mm_movehl_ps (vmax, vmax));
+    vmax = _mm_max_ss (vmax, _mm_shuffle_ps (vmax, vmax, 1));
+    max_val = _mm_cvtss_f32 (vmax);
+  }
+#endif
+  for (; c < n; c++)
+    max_val = scores[c] > max_val ? scores[c] : max_val;
+
+  return max_val;
+}
+
+#define GST_SSCMA_DECODE_BATCH 64 /**< survivors a decoder keeps before writing them out */
+
+/**
+ * @brief Anchors that passed the threshold, waiting to be projected into results.
+ *
+ * Kept as parallel arrays on the stack, results grows once per batch
+ * instead of once per box.
+ */
+typedef struct
+{
+  guint count;
+  int anchor[GST_SSCMA_DECODE_BATCH]; /**< row of the anchor in the output blob */
+  int class_id[GST_SSCMA_DECODE_BATCH];
+  gfloat score[GST_SSCMA_DECODE_BATCH]; /**< best class score */
+  gfloat prob[GST_SSCMA_DECODE_BATCH]; /**< score * objectness */
+} GstSscmaSurvivors;
+
+/**
+ * @brief Project the boxes of a yolov5 blob's survivors into results and empty the batch.
+ */
+static void
+gst_sscma_survivors_flush (GstSscmaSurvivors * survivors, const float *data,
+    int stride, const GstSscmaDecodeParams * params, GArray * results)
+{
+  const guint first = results->len;
+
+  if (survivors->count == 0)
+    return;
+
+  g_array_set_size (results, first + survivors->count);
+  for (guint i = 0; i < survivors->count; i++)
+    gst_sscma_project_box (data + survivors->anchor[i] * stride,
+        survivors->class_id[i], survivors->score[i], survivors->prob[i],
+        params->is_output_scaled, params,
+        &g_array_index (results, detectedObject, first + i));
+  survivors->count = 0;
+}
+
+/**
+ * @brief Decode a yolov5 output blob, one row of box, objectness and class scores per anchor.
+ *
+ * An anchor whose objectness times the largest class score of the head
+ * (params->max_score) does not pass the threshold cannot pass it: most
+ * anchors are dropped on row[4] alone. The
+ * class scores of the others are scanned with SIMD, without tracking the
+ * index, which is only looked up for the few anchors passing the threshold.
+ * NUM_CLASSES and NUM_ANCHORS are 0 when only known at runtime, fixed ones
+ * give the loops a constant trip count.
+ */
+template <int NUM_CLASSES, int NUM_ANCHORS>
+static void
+gst_sscma_decode_yolov5_rows (const ncnn::Mat * outs, guint num_outs,
+    const GstSscmaDecodeParams * params, GArray * results)
+{
+  const ncnn::Mat & out = outs[0];
+  const int num_classes = NUM_CLASSES > 0 ? NUM_CLASSES
+      : out.w - DETECTION_NUM_INFO;
+  const int num_anchors = NUM_ANCHORS > 0 ? NUM_ANCHORS : out.h;
+  const int stride = DETECTION_NUM_INFO + num_classes;
+  const float *data = (const float *) out.data;
+  const gfloat threshold = params->threshold;
+  /* without a known max score only anchors without objectness are dropped */
+  const gfloat min_objectness = params->max_score > 0.f ?
+      threshold / params->max_score : 0.f;
+  GstSscmaSurvivors survivors;
+
+  survivors.count = 0;
+  for (int anchor = 0; anchor < num_anchors; anchor++) {
+    const float *row = data + anchor * stride;
+    const float *scores = row + DETECTION_NUM_INFO;
+    float max_val;
+    int class_id;
+
+    /* also drops a NaN objectness */
+    if (!(row[4] > min_objectness))
+      continue;
+
+    // If the maximum confidence is greater than the threshold, then the result is valid
+    max_val = gst_sscma_max_score (scores, num_classes);
+    if (!(max_val > 0.f) || max_val * row[4] <= threshold)
+      continue;
+
+    class_id = 0;
+    while (scores[class_id] != max_val)
+      class_id++;
+    survivors.anchor[survivors.count] = anchor;
+    survivors.class_id[survivors.count] = class_id;
+    survivors.score[survivors.count] = max_val;
+    survivors.prob[survivors.count] = max_val * row[4];
+    if (++survivors.count == GST_SSCMA_DECODE_BATCH)
+      gst_sscma_survivors_flush (&survivors, data, stride, params, results);
+  }
+  gst_sscma_survivors_flush (&survivors, data, stride, params, results);
+}
+
+/**
+ * @brief Decode a yolov8 / yolov11 output blob: anchor-free, no objectness.
+ *
+ * The head outputs [4 + classes, anchors], one row per channel, so an
+ * anchor's scores are a column. Exports that transposed it to one row per
+ * anchor are read as such.
+ */
+template <int NUM_CLASSES>
+static void
+gst_sscma_decode_yolov8 (const ncnn::Mat * outs, guint num_outs,
+    const GstSscmaDecodeParams * params, GArray * results)
+{
+  const ncnn::Mat & out = outs[0];
+  const gboolean transposed = out.w >= out.h;
+  const int channels = transposed ? out.h : out.w;
+  const int num_anchors = transposed ? out.w : out.h;
+  const int num_classes = NUM_CLASSES > 0 ? NUM_CLASSES : channels - 4;
+  /* distance between two channels, and between two anchors */
+  const int channel_step = transposed ? num_anchors : 1;
+  const int anchor_step = transposed ? 1 : channels;
+  const float *data = (const float *) out.data;
+
+  for (int anchor = 0; anchor < num_anchors; anchor++) {
+    const float *col = data + anchor * anchor_step;
+    const float *scores = col + 4 * channel_step;
+    float max_val = 0.f, box[4];
+    int class_id = 0;
+
+    /* a NaN score never compares greater, it is skipped */
+    for (int c = 0; c < num_classes; c++) {
+      if (scores[c * channel_step] > max_val) {
+        max_val = scores[c * channel_step];
+        class_id = c;
+      }
+    }
+    if (max_val <= params->threshold)
+      continue;
+
+    for (int k = 0; k < 4; k++)
+      box[k] = col[k * channel_step];
+    gst_sscma_append_box (box, class_id, max_val, max_val,
+        params->is_output_scaled, params, results);
+  }
+}
+
+#define SIGMOID_RANGE 16 /**< the table covers [-16, 16], sigmoid is 0 or 1 within 1e-7 beyond */
+#define SIGMOID_STEPS 64 /**< table entries per unit, linear interpolation error < 1e-5 */
+#define SIGMOID_SIZE (2 * SIGMOID_RANGE * SIGMOID_STEPS + 1)
+
+static float sigmoid_table[SIGMOID_SIZE];
+
+/**
+ * @brief Fill the sigmoid table, once per process.
+ */
+static void
+gst_sscma_sigmoid_init (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized)) {
+    for (int i = 0; i < SIGMOID_SIZE; i++)
+      sigmoid_table[i] = 1.f / (1.f + expf (SIGMOID_RANGE
+              - (float) i / SIGMOID_STEPS));
+    g_once_init_leave (&initialized, 1);
+  }
+}
+
+/**
+ * @brief Sigmoid interpolated from the table, see gst_sscma_sigmoid_init.
+ */
+static inline float
+gst_sscma_sigmoid (float x)
+{
+  const float pos = (x + SIGMOID_RANGE) * SIGMOID_STEPS;
+  int i;
+
+  /* also catches NaN */
+  if (!(pos > 0.f))
+    return sigmoid_table[0];
+  if (pos >= SIGMOID_SIZE - 1)
+    return sigmoid_table[SIGMOID_SIZE - 1];
+
+  i = (int) pos;
+  return sigmoid_table[i] + (pos - i) * (sigmoid_table[i + 1] - sigmoid_table[i]);
+}
+
+/**
+ * @brief Decode raw yolov5 detection heads, before the grid and anchor decode.
+ *
+ * Each head is one blob of 3 channels, one per anchor, holding a row of box,
+ * objectness and class logits per grid cell. The stride of a head follows
+ * from its number of cells, the head with the i-th smallest stride uses the
+ * i-th anchor set.
+ *
+ * Both sigmoids of the score are at most 1, so the objectness and the best
+ * class must each pass the threshold alone. These checks are done on the
+ * logits against logit(threshold): most cells are dropped on their
+ * objectness without a sigmoid or a class scan. The sigmoids of the few
+ * remaining cells come from a table.
+ */
+static void
+gst_sscma_decode_yolov5_raw (const ncnn::Mat * outs, guint num_outs,
+    const GstSscmaDecodeParams * params, GArray * results)
+{
+  const int in_w = params->transform->width;
+  const int in_h = params->transform->height;
+  /* logit (threshold), what the objectness and best class logits must pass */
+  const float min_logit = params->threshold > 0.f && params->threshold < 1.f ?
+      logf (params->threshold / (1.f - params->threshold)) : -G_MAXFLOAT;
+  int strides[GST_SSCMA_MAX_OUTPUTS];
+  guint i, j;
+
+  for (i = 0; i < num_outs; i++)
+    strides[i] = outs[i].h > 0 ?
+        (int) (sqrtf ((float) in_w * in_h / outs[i].h) + 0.5f) : 0;
+
+  for (i = 0; i < num_outs; i++) {
+    const ncnn::Mat & out = outs[i];
+    const int num_classes = out.w - DETECTION_NUM_INFO;
+    const int stride = strides[i];
+    guint rank = 0;
+    const gfloat *anchors;
+
+    if (stride == 0 || num_classes <= 0 || out.c > GST_SSCMA_ANCHORS_PER_HEAD)
+      continue;
+    for (j = 0; j < num_outs; j++)
+      rank += strides[j] < stride;
+    if (rank >= params->num_anchor_sets)
+      continue;
+    anchors = params->anchors[rank];
+
+    const int grid_w = in_w / stride;
+    for (int q = 0; q < out.c; q++) {
+      const ncnn::Mat head = out.channel (q);
+
+      for (int cell = 0; cell < out.h; cell++) {
+        const float *row = head.row (cell);
+        const float *logits = row + DETECTION_NUM_INFO;
+        float max_logit = -G_MAXFLOAT, score, prob, box[4], w, h;
+        int class_id = 0;
+
+        if (row[4] < min_logit)
+          continue;
+        /* a NaN logit never compares greater, it is skipped */
+        for (int c = 0; c < num_classes; c++) {
+          if (logits[c] > max_logit) {
+            max_logit = logits[c];
+            class_id = c;
+          }
+        }
+        if (max_logit < min_logit)
+          continue;
+        score = gst_sscma_sigmoid (max_logit);
+        prob = score * gst_sscma_sigmoid (row[4]);
+        if (prob <= params->threshold)
+          continue;
+
+        w = gst_sscma_sigmoid (row[2]) * 2.f;
+        h = gst_sscma_sigmoid (row[3]) * 2.f;
+        box[0] = (gst_sscma_sigmoid (row[0]) * 2.f - 0.5f + cell % grid_w)
+            * stride;
+        box[1] = (gst_sscma_sigmoid (row[1]) * 2.f - 0.5f + cell / grid_w)
+            * stride;
+        box[2] = w * w * anchors[2 * q];
+        box[3] = h * h * anchors[2 * q + 1];
+        gst_sscma_append_box (box, class_id, score, prob, TRUE, params,
+            results);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Pick the decoder for the output blobs of a head.
+ *
+ * Common layouts, COCO-80 at 320 and 640 input and single-class models, get
+ * a specialized decoder; other shapes use the generic one of the head.
+ * @return NULL if the blobs do not fit the head
+ */
+GstSscmaDecodeFunc
+gst_sscma_decoder_select (GstSscmaDecoder decoder, const ncnn::Mat * outs,
+    guint num_outs)
+{
+  if (num_outs == 0 || outs[0].empty ())
+    return NULL;
+
+  switch (decoder) {
+    case GST_SSCMA_DECODER_YOLOV5:
+      if (outs[0].w <= DETECTION_NUM_INFO)
+        return NULL;
+      switch (outs[0].w - DETECTION_NUM_INFO) {
+        case 80:
+          if (outs[0].h == 6300)
+            return gst_sscma_decode_yolov5_rows <80, 6300>;
+          if (outs[0].h == 25200)
+            return gst_sscma_decode_yolov5_rows <80, 25200>;
+          return gst_sscma_decode_yolov5_rows <80, 0>;
+        case 1:
+          return gst_sscma_decode_yolov5_rows <1, 0>;
+        default:
+          return gst_sscma_decode_yolov5_rows <0, 0>;
+      }
+    case GST_SSCMA_DECODER_YOLOV8:
+      if (MIN (outs[0].w, outs[0].h) <= 4)
+        return NULL;
+      if (MIN (outs[0].w, outs[0].h) == 84)
+        return gst_sscma_decode_yolov8 <80>;
+      return gst_sscma_decode_yolov8 <0>;
+    case GST_SSCMA_DECODER_YOLOV5_RAW:
+      gst_sscma_sigmoid_init ();
+      return gst_sscma_decode_yolov5_raw;
+    default:
+      return NULL;
+  }
+}
+
+/**
+ * @brief Decode output blobs into detections in source frame coordinates.
+ * @param outs the output blobs of the head, in output-blobs order
+ * @param params threshold, input geometry and anchors
+ * @param results detections are appended to it
+ * @return FALSE if the blobs do not fit the head
+ */
+gboolean
+gst_sscma_decode (GstSscmaDecoder decoder, const ncnn::Mat * outs,
+    guint num_outs, const GstSscmaDecodeParams * params, GArray * results)
+{
+  GstSscmaDecodeFunc decode = gst_sscma_decoder_select (decoder, outs,
+      num_outs);
+
+  if (decode == NULL)
+    return FALSE;
+  decode (outs, num_outs, params, results);
+  return TRUE;
+}
+
+/**
+ * @brief Compare Function for g_array_sort with detectedObject.
+ */
+static gint
+compare_detection (gconstpointer _a, gconstpointer _b)
+{
+  const detectedObject *a = (const detectedObject *) _a;
+  const detectedObject *b = (const detectedObject *) _b;
+
+  /* Larger comes first */
+  return (a->prob > b->prob) ? -1 : ((a->prob == b->prob) ? 0 : 1);
+}
+
+/**
+ * @brief Calculate the intersected surface
+ */
+static gfloat
+iou (detectedObject * a, detectedObject * b)
+{
+  int x1 = MAX (a->x, b->x);
+  int y1 = MAX (a->y, b->y);
+  int x2 = MIN (a->x + a->width, b->x + b->width);
+  int y2 = MIN (a->y + a->height, b->y + b->height);
+  int w = MAX (0, (x2 - x1 + 1));
+  int h = MAX (0, (y2 - y1 + 1));
+  float inter = w * h;
+  float areaA = a->width * a->height;
+  float areaB = b->width * b->height;
+  float o = inter / (areaA + areaB - inter);
+  return (o >= 0) ? o : 0;
+}
+
+/**
+ * @brief Apply NMS to the given results (objects[MOBILENET_SSD_DETECTION_MAX])
+ * @param[in/out] results The results to be filtered with nms
+ */
+void
+gst_sscma_nms (GArray * results, gfloat threshold)
+{
+  guint boxes_size;
+  guint i, j;
+
+  boxes_size = results->len;
+  if (boxes_size == 0U)
+    return;
+
+  g_array_sort (results, compare_detection);
+
+  for (i = 0; i < boxes_size; i++) {
+    detectedObject *a = &g_array_index (results, detectedObject, i);
+    if (a->valid == TRUE) {
+      for (j = i + 1; j < boxes_size; j++) {
+        detectedObject *b = &g_array_index (results, detectedObject, j);
+        if (b->valid == TRUE) {
+          if (iou (a, b) > threshold) {
+            b->valid = FALSE;
+          }
+        }
+      }
+    }
+  }
+
+  i = 0;
+  do {
+    detectedObject *a = &g_array_index (results, detectedObject, i);
+    if (a->valid == FALSE)
+      g_array_remove_index (results, i);
+    else
+      i++;
+  } while (i < results->len);
+
+}
+
+/**
+ * @brief How much two detection sets differ.
+ * @return the fraction of boxes without a same-class match of IoU >= 0.5 in
+ * the other set, 0 if both sets are empty
+ */
+gfloat
+gst_sscma_results_change (GArray * prev, GArray * cur)
+{
+  guint i, j, matched = 0;
+  const guint total = MAX (prev->len, cur->len);
+
+  if (total == 0)
+    return 0.f;
+
+  for (i = 0; i < cur->len; i++) {
+    detectedObject *a = &g_array_index (cur, detectedObject, i);
+    for (j = 0; j < prev->len; j++) {
+      detectedObject *b = &g_array_index (prev, detectedObject, j);
+      if (a->class_id == b->class_id && iou (a, b) >= 0.5f) {
+        matched++;
+        break;
+      }
+    }
+  }
+
+  return 1.f - (gfloat) MIN (matched, total) / total;
+}
+
+/* red, in limited range BT.601 YUV */
+#define DRAW_Y 81
+#define DRAW_U 90
+#define DRAW_V 240
+
+/**
+ * @brief Paint one pixel of a frame: the red channel of RGB frames, red for YUV ones.
+ *
+ * YUV frames share chroma between neighbouring pixels, which get tinted too.
+ */
+static inline void
+gst_sscma_draw_pixel (const GstSscmaImage * image, int x, int y)
+{
+  guint8 *p;
+
+  switch (image->format) {
+    case GST_SSCMA_PIXEL_RGB:
+    case GST_SSCMA_PIXEL_BGR:
+    case GST_SSCMA_PIXEL_RGBA:
+    case GST_SSCMA_PIXEL_BGRA:
+      image->planes[0][y * image->strides[0]
+          + x * gst_sscma_pixel_stride (image->format)
+          + gst_sscma_pixel_red_offset (image->format)] = PIXEL_VALUE;
+      break;
+    case GST_SSCMA_PIXEL_NV12:
+      image->planes[0][y * image->strides[0] + x] = DRAW_Y;
+      p = image->planes[1] + y / 2 * image->strides[1] + x / 2 * 2;
+      p[0] = DRAW_U;
+      p[1] = DRAW_V;
+      break;
+    case GST_SSCMA_PIXEL_I420:
+      image->planes[0][y * image->strides[0] + x] = DRAW_Y;
+      image->planes[1][y / 2 * image->strides[1] + x / 2] = DRAW_U;
+      image->planes[2][y / 2 * image->strides[2] + x / 2] = DRAW_V;
+      break;
+    case GST_SSCMA_PIXEL_YUY2:
+      p = image->planes[0] + y * image->strides[0] + x / 2 * 4;
+      p[x % 2 * 2] = DRAW_Y;
+      p[1] = DRAW_U;
+      p[3] = DRAW_V;
+      break;
+  }
+}
+
+/**
+ * @brief Draw with the given results (objects[MOBILENET_SSD_DETECTION_MAX]) to the output buffer
+ * @param[out] image The output frame, drawn in its own format
+ * @param[in] labels The class names, indexed by class_id
+ * @param[in] results The final results to be drawn.
+ */
+void
+gst_sscma_draw (const GstSscmaImage * image, char ** labels,
+    guint total_labels, GArray * results)
+{
+  const int width = image->width, height = image->height;
+  unsigned int i;
+
+  for (i = 0; i < results->len; i++) {
+    int x1, x2, y1, y2;         /* Box positions on the output surface */
+    int j;
+    detectedObject *a = &g_array_index (results, detectedObject, i);
+
+    if ((a->class_id < 0 ||
+                a->class_id >= (int) total_labels)) {
+      /** @todo make it "logw_once" after we get logw_once API. */
+      g_print ("Invalid class found with tensordec-boundingbox.c.\n");
+      continue;
+    }
+
+    /* results reused across a caps change may lie outside the frame */
+    if (a->x >= width || a->y >= height || a->x + a->width < 0
+        || a->y + a->height < 0)
+      continue;
+
+    /* 1. Draw Boxes */
+    x1 = MAX (0, a->x);
+    x2 = MIN (width - 1, (a->x + a->width));
+    y1 = MAX (0, a->y);
+    y2 = MIN (height - 1, (a->y + a->height));
+    /* 1-1. Horizontal */
+    for (j = x1; j <= x2; j++) {
+      gst_sscma_draw_pixel (image, j, y1);
+      gst_sscma_draw_pixel (image, j, y2);
+    }
+
+    /* 1-2. Vertical */
+    for (j = y1 + 1; j < y2; j++) {
+      gst_sscma_draw_pixel (image, x1, j);
+      gst_sscma_draw_pixel (image, x2, j);
+    }
+
+    /* 2. Write Labels + tracking ID */
+    gchar label[64];
+    gsize label_len;
+    g_snprintf (label, sizeof (label), "%s %d", labels[a->class_id],
+            a->tracking_id);
+    label_len = strlen (label);
+    /* x1 is the same: x1 = MAX (0, (width * a->x) / bdata->i_width); */
+    y1 = MAX (0, (y1 - 14));
+    for (guint j = 0; j < label_len; j++) {
+      unsigned int char_index = label[j];
+      if (char_index < 32 || char_index >= 127) {
+        /* It's not ASCII */
+        char_index = '*';
+      }
+      char_index -= 32;
+      if (x1 + 8 > width)
+        break;                /* Stop drawing if it may overfill */
+      for (y2 = 0; y2 < 13 && y1 + y2 < height; y2++) {
+        /* 13 : character height */
+        for (x2 = 0; x2 < 8; x2++) {
+          /* 8: character width */
+          if (rasters[char_index][13 - y2] & (1 << (7 - x2)))
+            gst_sscma_draw_pixel (image, x1 + x2, y1 + y2);
+        }
+      }
+      x1 += 9;                  /* charater width + 1px */
+    }
+  }
+}
+
+/**
+ * @brief Convert the given results (objects[MOBILENET_SSD_DETECTION_MAX]) to json format
+ * @param[in] outbuf The output buffer (json format)
+ * @param[in] imgdata The mapped input frame (RGB plain)
+ * @param[in] results The final results to be converted.
+ * @return The size of json format
+ * 
+ * outbuf json format:
+ * {
+ *  "type": 1,
+ *  "name": "INVOKE",
+ *  "code": 0,
+ *  "data": {
+ *    "count": 8,
+ *    "perf": [8, 365, 0],
+ *    "boxes": [[87,83,77,65,70,0],[...]]
+*    "image": "<BASE64JPEG:String>"
+ *  }
+ * }
+ */
+guint
+gst_sscma_convert_json (char ** outbuf, const GstMapInfo * imgdata,
+    GArray * results, GArray * infer_time)
+{
+
+  JsonObject *json;
+  JsonNode *root;
+  JsonGenerator *generator;
+
+  /* create json */
+  json = json_object_new ();
+  json_object_set_int_member (json, "type", 1);
+  json_object_set_string_member (json, "name", "INVOKE");
+  json_object_set_int_member (json, "code", 0);
+
+  JsonObject *data = json_object_new ();
+  json_object_set_int_member (data, "count", results->len);
+
+  JsonArray *perf = json_array_new ();
+  for (guint i = 0; i < infer_time->len; i++) {
+    json_array_add_int_element (perf, g_array_index (infer_time, guint, i));
+  }
+  json_object_set_array_member (data, "perf", perf);
+
+  JsonArray *boxes = json_array_new ();
+  for (guint i = 0; i < results->len; i++) {
+    detectedObject *a = &g_array_index (results, detectedObject, i);
+    JsonArray *box = json_array_new ();
+    json_array_add_int_element (box, a->x);
+    json_array_add_int_element (box, a->y);
+    json_array_add_int_element (box, a->width);
+    json_array_add_int_element (box, a->height);
+    json_array_add_int_element (box, a->tracking_id);
+    json_array_add_int_element (box, a->class_id);
+    json_array_add_array_element (boxes, box);
+  }
+  json_object_set_array_member (data, "boxes", boxes);
+
+  /* imgdata to base64 */
+  g_autofree gchar *base64 = NULL;
+  gsize base64_len;
+  base64 = g_base64_encode (imgdata->data, imgdata->size);
+  base64_len = strlen (base64);
+  json_object_set_string_member (data, "image", base64);
+
+  json_object_set_object_member (json, "data", data);
+
+  /* convert JSON to string */
+  /* Make it the root node */
+  root = json_node_init_object (json_node_alloc (), json);
+  generator = json_generator_new ();
+  json_generator_set_indent (generator, 2);
+  json_generator_set_indent_char (generator, ' ');
+  json_generator_set_pretty (generator, TRUE);
+  json_generator_set_root (generator, root);
+  *outbuf = json_generator_to_data (generator, NULL);
+
+  g_object_unref (generator);
+  json_node_free (root);
+  json_object_unref (json);
+
+  return strlen (*outbuf);
+}
+
+/**
+ * @brief Build the text/x-json buffer pushed in place of a frame.
+ * @param buf the frame, its timestamps, flags and metadata are copied over
+ * @param imgdata the mapped frame
+ * @return a new buffer owning the json text
+ */
+GstBuffer *
+gst_sscma_json_buffer (GstBuffer * buf, const GstMapInfo * imgdata,
+    GArray * results, GArray * infer_time)
+{
+  GstBuffer *json_buf;
+  gchar *outbuf_data;
+  guint outbuf_size;
+
+  outbuf_size = gst_sscma_convert_json (&outbuf_data, imgdata, results,
+      infer_time);
+  json_buf = gst_buffer_new_wrapped (outbuf_data, outbuf_size);
+
+  gst_buffer_copy_into (json_buf, buf,
+    GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS |
+    GST_BUFFER_COPY_METADATA, 0, -1);
+
+  return json_buf;
+}
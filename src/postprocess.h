@@ -0,0 +1,87 @@
+#ifndef __GST_SSCMA_POSTPROCESS_H__
+#define __GST_SSCMA_POSTPROCESS_H__
+
+#include <gst/gst.h>
+#include <mat.h>
+#include "preprocess.h"
+
+#define DETECTION_NUM_INFO 5
+#define PIXEL_VALUE                             (0xFF)
+
+/** @brief Represents a detect object */
+typedef struct
+{
+  int valid;
+  int class_id;
+  int x;
+  int y;
+  int width;
+  int height;
+  gfloat prob;
+
+  int tracking_id;
+} detectedObject;
+
+/**
+ * @brief Class names of a model, refcounted so that frames in flight keep
+ * the names they were inferred with when the labels file changes.
+ */
+typedef struct
+{
+  gint refcount;
+  char **names; /**< NULL terminated, indexed by class_id */
+  guint count; /**< number of names */
+  guint max_word_length; /**< length of the longest name */
+} GstSscmaLabels;
+
+GstSscmaLabels * gst_sscma_labels_new_from_file (const gchar * path,
+    GError ** error);
+GstSscmaLabels * gst_sscma_labels_ref (GstSscmaLabels * labels);
+void gst_sscma_labels_unref (GstSscmaLabels * labels);
+
+#define GST_SSCMA_MAX_OUTPUTS 4 /**< max output blobs of a head */
+#define GST_SSCMA_ANCHORS_PER_HEAD 3 /**< anchors of a raw yolov5 head */
+
+/**
+ * @brief Output head of the network, i.e. how its output blobs hold the boxes.
+ */
+typedef enum
+{
+  GST_SSCMA_DECODER_YOLOV5 = 0, /**< one [anchors, 5 + classes] blob with objectness */
+  GST_SSCMA_DECODER_YOLOV8, /**< one [4 + classes, anchors] blob, anchor-free (yolov8, yolov11) */
+  GST_SSCMA_DECODER_YOLOV5_RAW, /**< one blob per stride of logits needing the grid and anchor decode */
+} GstSscmaDecoder;
+
+/**
+ * @brief What a decoder needs besides the output blobs.
+ */
+typedef struct
+{
+  gfloat threshold; /**< min score of a detection */
+  gboolean is_output_scaled; /**< FALSE if boxes are normalized to the model input */
+  const GstSscmaInputTransform *transform; /**< how the frame was mapped onto the model input */
+  guint width; /**< width of the source frame */
+  guint height; /**< height of the source frame */
+  const gfloat (*anchors)[2 * GST_SSCMA_ANCHORS_PER_HEAD]; /**< raw heads: w,h pairs per head, smallest stride first */
+  guint num_anchor_sets; /**< number of anchor sets */
+  gfloat max_score; /**< yolov5: largest class score of the head, anchors whose objectness times it does not pass are skipped, 0 if unknown */
+} GstSscmaDecodeParams;
+
+/** @brief Decoder of one output head layout, see gst_sscma_decode */
+typedef void (*GstSscmaDecodeFunc) (const ncnn::Mat * outs, guint num_outs,
+    const GstSscmaDecodeParams * params, GArray * results);
+
+GstSscmaDecodeFunc gst_sscma_decoder_select (GstSscmaDecoder decoder,
+    const ncnn::Mat * outs, guint num_outs);
+gboolean gst_sscma_decode (GstSscmaDecoder decoder, const ncnn::Mat * outs,
+    guint num_outs, const GstSscmaDecodeParams * params, GArray * results);
+void gst_sscma_nms (GArray * results, gfloat threshold);
+gfloat gst_sscma_results_change (GArray * prev, GArray * cur);
+void gst_sscma_draw (const GstSscmaImage * image, char ** labels,
+    guint total_labels, GArray * results);
+guint gst_sscma_convert_json (char ** outbuf, const GstMapInfo * imgdata,
+    GArray * results, GArray * infer_time);
+GstBuffer * gst_sscma_json_buffer (GstBuffer * buf, const GstMapInfo * imgdata,
+    GArray * results, GArray * infer_time);
+
+#endif /* __GST_SSCMA_POSTPROCESS_H__ */
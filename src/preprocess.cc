@@ -0,0 +1,511 @@
+#include <string.h>
+#include "preprocess.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Bytes between two pixels of a row of the first plane, 1 for planar YUV.
+ */
+int
+gst_sscma_pixel_stride (GstSscmaPixelFormat format)
+{
+  switch (format) {
+    case GST_SSCMA_PIXEL_RGB:
+    case GST_SSCMA_PIXEL_BGR:
+      return 3;
+    case GST_SSCMA_PIXEL_RGBA:
+    case GST_SSCMA_PIXEL_BGRA:
+      return 4;
+    case GST_SSCMA_PIXEL_YUY2:
+      return 2;
+    default:
+      return 1;
+  }
+}
+
+/**
+ * @brief Offset of the red byte in a pixel of a packed RGB format, -1 for YUV.
+ */
+int
+gst_sscma_pixel_red_offset (GstSscmaPixelFormat format)
+{
+  switch (format) {
+    case GST_SSCMA_PIXEL_RGB:
+    case GST_SSCMA_PIXEL_RGBA:
+      return 0;
+    case GST_SSCMA_PIXEL_BGR:
+    case GST_SSCMA_PIXEL_BGRA:
+      return 2;
+    default:
+      return -1;
+  }
+}
+
+/**
+ * @brief Map the frame onto the whole target_width x target_height input, ignoring the aspect ratio.
+ */
+void
+gst_sscma_input_transform_stretch (int width, int height, int target_width,
+    int target_height, GstSscmaInputTransform * transform)
+{
+  transform->width = transform->resized_width = target_width;
+  transform->height = transform->resized_height = target_height;
+  transform->pad_left = transform->pad_top = 0;
+  transform->scale_x = (float) target_width / width;
+  transform->scale_y = (float) target_height / height;
+}
+
+/**
+ * @brief Scale the frame so its longest side is max_side, then pad to a multiple of align.
+ *
+ * A 16:9 frame with max_side 320 becomes a 320x180 image in a 320x192 input,
+ * instead of being stretched over 320x320.
+ */
+void
+gst_sscma_input_transform_letterbox (int width, int height, int max_side,
+    int align, GstSscmaInputTransform * transform)
+{
+  const float scale = MIN ((float) max_side / width, (float) max_side / height);
+
+  transform->resized_width = CLAMP ((int) (width * scale + 0.5f), 1, max_side);
+  transform->resized_height = CLAMP ((int) (height * scale + 0.5f), 1, max_side);
+  transform->width = (transform->resized_width + align - 1) / align * align;
+  transform->height = (transform->resized_height + align - 1) / align * align;
+  transform->pad_left = (transform->width - transform->resized_width) / 2;
+  transform->pad_top = (transform->height - transform->resized_height) / 2;
+  /* the rounded sizes, so that boxes project back exactly */
+  transform->scale_x = (float) transform->resized_width / width;
+  transform->scale_y = (float) transform->resized_height / height;
+}
+
+/**
+ * @brief Free the sampling positions of a resize table, it can be reused after.
+ */
+void
+gst_sscma_resize_table_clear (GstSscmaResizeTable * table)
+{
+  g_free (table->x0);
+  g_free (table->wx);
+  g_free (table->rows);
+  memset (table, 0, sizeof (*table));
+}
+
+/**
+ * @brief Make the table sample roi into a width x height image, a no-op if it already does.
+ *
+ * Positions follow the usual bilinear convention, (d + 0.5) * scale - 0.5,
+ * clamped to the region.
+ */
+static void
+gst_sscma_resize_table_update (GstSscmaResizeTable * table,
+    const GstSscmaTile * roi, int width, int height)
+{
+  int i;
+
+  if (table->x0 && table->width == width && table->height == height
+      && memcmp (&table->roi, roi, sizeof (*roi)) == 0)
+    return;
+
+  gst_sscma_resize_table_clear (table);
+  table->roi = *roi;
+  table->width = width;
+  table->height = height;
+  table->x0 = g_new (int, 2 * (width + height));
+  table->x1 = table->x0 + width;
+  table->y0 = table->x1 + width;
+  table->y1 = table->y0 + height;
+  table->wx = g_new (float, width + height);
+  table->wy = table->wx + width;
+  table->rows = g_new (float, 6 * width);
+
+  for (i = 0; i < width; i++) {
+    const float fx = CLAMP ((i + 0.5f) * roi->width / width - 0.5f, 0.f,
+        roi->width - 1.f);
+
+    table->x0[i] = roi->x + (int) fx;
+    table->x1[i] = MIN (table->x0[i] + 1, roi->x + roi->width - 1);
+    table->wx[i] = fx - (int) fx;
+  }
+  for (i = 0; i < height; i++) {
+    const float fy = CLAMP ((i + 0.5f) * roi->height / height - 0.5f, 0.f,
+        roi->height - 1.f);
+
+    table->y0[i] = roi->y + (int) fy;
+    table->y1[i] = MIN (table->y0[i] + 1, roi->y + roi->height - 1);
+    table->wy[i] = fy - (int) fy;
+  }
+}
+
+/**
+ * @brief Set n floats to the letterbox padding value.
+ */
+static inline void
+gst_sscma_fill_span (float * span, int n)
+{
+  for (int i = 0; i < n; i++)
+    span[i] = GST_SSCMA_LETTERBOX_PAD_VALUE;
+}
+
+/**
+ * @brief Write the letterbox padding around the resized frame, leaving the frame itself alone.
+ */
+static void
+gst_sscma_fill_padding (const GstSscmaInputTransform * transform,
+    ncnn::Mat & in)
+{
+  const int right = transform->pad_left + transform->resized_width;
+  const int bottom = transform->pad_top + transform->resized_height;
+  int q, x, y;
+
+  if (transform->width == transform->resized_width
+      && transform->height == transform->resized_height)
+    return;
+
+  for (q = 0; q < in.c; q++) {
+    /* whole rows above and below the frame, a row is contiguous */
+    for (y = 0; y < transform->pad_top; y++)
+      gst_sscma_fill_span ((float *) in.channel (q).row (y), in.w);
+    for (y = bottom; y < in.h; y++)
+      gst_sscma_fill_span ((float *) in.channel (q).row (y), in.w);
+
+    /* left and right of the frame rows */
+    if (transform->pad_left == 0 && right == in.w)
+      continue;
+    for (y = transform->pad_top; y < bottom; y++) {
+      float *row = (float *) in.channel (q).row (y);
+
+      for (x = 0; x < transform->pad_left; x++)
+        row[x] = GST_SSCMA_LETTERBOX_PAD_VALUE;
+      for (x = right; x < in.w; x++)
+        row[x] = GST_SSCMA_LETTERBOX_PAD_VALUE;
+    }
+  }
+}
+
+/**
+ * @brief out = top * (1 - wy) / 255 + bottom * wy / 255 over n floats.
+ */
+static inline void
+gst_sscma_blend_rows (const float * top, const float * bottom, float wy,
+    float * out, int n)
+{
+  const float a = (1.f - wy) / 255.f, b = wy / 255.f;
+  int i = 0;
+
+#if defined(__ARM_NEON)
+  const float32x4_t va = vdupq_n_f32 (a), vb = vdupq_n_f32 (b);
+
+  for (; i + 4 <= n; i += 4)
+    vst1q_f32 (out + i, vmlaq_f32 (vmulq_f32 (vld1q_f32 (top + i), va),
+            vld1q_f32 (bottom + i), vb));
+#elif defined(__SSE2__)
+  const __m128 va = _mm_set1_ps (a), vb = _mm_set1_ps (b);
+
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps (out + i, _mm_add_ps (_mm_mul_ps (_mm_loadu_ps (top + i), va),
+            _mm_mul_ps (_mm_loadu_ps (bottom + i), vb)));
+#endif
+  for (; i < n; i++)
+    out[i] = top[i] * a + bottom[i] * b;
+}
+
+/**
+ * @brief Horizontally resize one source row of a packed RGB frame into R, G and B float rows.
+ */
+template <int BPP, int RED>
+static inline void
+gst_sscma_resize_row (const guint8 * row, const GstSscmaResizeTable * table,
+    float * out)
+{
+  const int n = table->width;
+  float *r = out, *g = out + n, *b = out + 2 * n;
+
+  for (int i = 0; i < n; i++) {
+    const guint8 *p0 = row + table->x0[i] * BPP;
+    const guint8 *p1 = row + table->x1[i] * BPP;
+    const float w = table->wx[i];
+
+    r[i] = p0[RED] + w * (p1[RED] - p0[RED]);
+    g[i] = p0[1] + w * (p1[1] - p0[1]);
+    b[i] = p0[2 - RED] + w * (p1[2 - RED] - p0[2 - RED]);
+  }
+}
+
+/**
+ * @brief Resize, deinterleave and normalize a region of a packed RGB frame in one pass.
+ *
+ * Each output row blends two horizontally resized source rows, kept in the
+ * table's row buffers so that an upscale reuses them across output rows. The blend
+ * and the 1/255 normalization are one SIMD multiply-add straight into the
+ * CHW planes.
+ */
+template <int BPP, int RED>
+static void
+gst_sscma_preprocess_packed (const GstSscmaImage * image,
+    const GstSscmaResizeTable * table,
+    const GstSscmaInputTransform * transform, ncnn::Mat & in)
+{
+  const int n = table->width;
+  float *top = table->rows, *bottom = table->rows + 3 * n;
+  int top_y = -1, bottom_y = -1;
+
+  for (int dy = 0; dy < table->height; dy++) {
+    const int y0 = table->y0[dy], y1 = table->y1[dy];
+
+    if (y0 != top_y) {
+      if (y0 == bottom_y) {
+        float *tmp = top;
+        top = bottom;
+        bottom = tmp;
+        top_y = bottom_y;
+        bottom_y = -1;
+      } else {
+        gst_sscma_resize_row <BPP, RED> (image->planes[0]
+            + y0 * image->strides[0], table, top);
+        top_y = y0;
+      }
+    }
+    if (y1 != bottom_y) {
+      gst_sscma_resize_row <BPP, RED> (image->planes[0]
+          + y1 * image->strides[0], table, bottom);
+      bottom_y = y1;
+    }
+
+    for (int q = 0; q < 3; q++)
+      gst_sscma_blend_rows (top + q * n, bottom + q * n, table->wy[dy],
+          (float *) in.channel (q).row (transform->pad_top + dy)
+          + transform->pad_left, n);
+  }
+}
+
+/**
+ * @brief Resize, convert and normalize a region of a YUV frame in one pass.
+ *
+ * Only the source pixels the bilinear resize reads are touched: luma is
+ * interpolated, chroma is taken from the nearest sample. The coefficients,
+ * limited or full range, are divided by 255, so the output comes out
+ * normalized.
+ */
+template <GstSscmaPixelFormat FORMAT>
+static void
+gst_sscma_preprocess_yuv (const GstSscmaImage * image,
+    const GstSscmaResizeTable * table,
+    const GstSscmaInputTransform * transform, ncnn::Mat & in)
+{
+  const int rw = table->width;
+  /* full range: the limited range coefficients times 219/255 (luma), 224/255 (chroma) */
+  const gboolean full = image->full_range;
+  const float y_offset = full ? 0.f : 16.f;
+  const float ky = (full ? 1.f : 1.164f) / 255.f;
+  const float kr = (image->bt709 ? (full ? 1.575f : 1.793f)
+      : (full ? 1.402f : 1.596f)) / 255.f;
+  const float kgu = (image->bt709 ? (full ? 0.187f : 0.213f)
+      : (full ? 0.344f : 0.391f)) / 255.f;
+  const float kgv = (image->bt709 ? (full ? 0.468f : 0.533f)
+      : (full ? 0.714f : 0.813f)) / 255.f;
+  const float kb = (image->bt709 ? (full ? 1.856f : 2.112f)
+      : (full ? 1.772f : 2.018f)) / 255.f;
+  /* packed YUY2 has a luma sample every other byte */
+  const int step = FORMAT == GST_SSCMA_PIXEL_YUY2 ? 2 : 1;
+  const int *x0 = table->x0, *x1 = table->x1;
+  const float *wx = table->wx;
+  int dx, dy;
+
+  for (dy = 0; dy < table->height; dy++) {
+    const float wy = table->wy[dy];
+    const int cy = wy < 0.5f ? table->y0[dy] : table->y1[dy];
+    const guint8 *l0 = image->planes[0] + table->y0[dy] * image->strides[0];
+    const guint8 *l1 = image->planes[0] + table->y1[dy] * image->strides[0];
+    const guint8 *c0, *c1 = NULL;
+    float *r = (float *) in.channel (0).row (transform->pad_top + dy)
+        + transform->pad_left;
+    float *g = (float *) in.channel (1).row (transform->pad_top + dy)
+        + transform->pad_left;
+    float *b = (float *) in.channel (2).row (transform->pad_top + dy)
+        + transform->pad_left;
+
+    if (FORMAT == GST_SSCMA_PIXEL_YUY2)
+      c0 = image->planes[0] + cy * image->strides[0];
+    else
+      c0 = image->planes[1] + cy / 2 * image->strides[1];
+    if (FORMAT == GST_SSCMA_PIXEL_I420)
+      c1 = image->planes[2] + cy / 2 * image->strides[2];
+
+    for (dx = 0; dx < rw; dx++) {
+      const int cx = (wx[dx] < 0.5f ? x0[dx] : x1[dx]) / 2;
+      const float top = l0[step * x0[dx]]
+          + wx[dx] * (l0[step * x1[dx]] - l0[step * x0[dx]]);
+      const float bottom = l1[step * x0[dx]]
+          + wx[dx] * (l1[step * x1[dx]] - l1[step * x0[dx]]);
+      const float luma = (top + wy * (bottom - top) - y_offset) * ky;
+      float u, v;
+
+      if (FORMAT == GST_SSCMA_PIXEL_NV12) {
+        u = c0[2 * cx] - 128.f;
+        v = c0[2 * cx + 1] - 128.f;
+      } else if (FORMAT == GST_SSCMA_PIXEL_I420) {
+        u = c0[cx] - 128.f;
+        v = c1[cx] - 128.f;
+      } else {
+        u = c0[4 * cx + 1] - 128.f;
+        v = c0[4 * cx + 3] - 128.f;
+      }
+
+      r[dx] = CLAMP (luma + kr * v, 0.f, 1.f);
+      g[dx] = CLAMP (luma - kgu * u - kgv * v, 0.f, 1.f);
+      b[dx] = CLAMP (luma + kb * u, 0.f, 1.f);
+    }
+  }
+}
+
+/**
+ * @brief Preprocess a region of a frame into the input described by transform.
+ *
+ * Only the pixels of roi are read, transform maps the roi (not the whole
+ * frame) onto the model input. Every format is resized, converted to RGB,
+ * normalized and written to the CHW planes in a single pass, the letterbox
+ * padding in place.
+ * @param table sampling positions, rebuilt only when the geometry changes,
+ *        NULL to build them for this call only
+ */
+void
+gst_sscma_preprocess_roi_transform (const GstSscmaImage * image,
+    const GstSscmaTile * roi, const GstSscmaInputTransform * transform,
+    GstSscmaResizeTable * table, ncnn::Mat & in, ncnn::Allocator * allocator)
+{
+  GstSscmaResizeTable local = { 0 };
+
+  if (table == NULL)
+    table = &local;
+  gst_sscma_resize_table_update (table, roi, transform->resized_width,
+      transform->resized_height);
+
+  in.create (transform->width, transform->height, 3, 4u, allocator);
+  gst_sscma_fill_padding (transform, in);
+
+  switch (image->format) {
+    case GST_SSCMA_PIXEL_RGB:
+      gst_sscma_preprocess_packed <3, 0> (image, table, transform, in);
+      break;
+    case GST_SSCMA_PIXEL_BGR:
+      gst_sscma_preprocess_packed <3, 2> (image, table, transform, in);
+      break;
+    case GST_SSCMA_PIXEL_RGBA:
+      gst_sscma_preprocess_packed <4, 0> (image, table, transform, in);
+      break;
+    case GST_SSCMA_PIXEL_BGRA:
+      gst_sscma_preprocess_packed <4, 2> (image, table, transform, in);
+      break;
+    case GST_SSCMA_PIXEL_NV12:
+      gst_sscma_preprocess_yuv <GST_SSCMA_PIXEL_NV12> (image, table, transform,
+          in);
+      break;
+    case GST_SSCMA_PIXEL_I420:
+      gst_sscma_preprocess_yuv <GST_SSCMA_PIXEL_I420> (image, table, transform,
+          in);
+      break;
+    case GST_SSCMA_PIXEL_YUY2:
+      gst_sscma_preprocess_yuv <GST_SSCMA_PIXEL_YUY2> (image, table, transform,
+          in);
+      break;
+  }
+
+  gst_sscma_resize_table_clear (&local);
+}
+
+/**
+ * @brief Preprocess a frame into the input described by transform.
+ */
+void
+gst_sscma_preprocess_transform (const GstSscmaImage * image,
+    const GstSscmaInputTransform * transform, GstSscmaResizeTable * table,
+    ncnn::Mat & in, ncnn::Allocator * allocator)
+{
+  const GstSscmaTile frame = { 0, 0, image->width, image->height };
+
+  gst_sscma_preprocess_roi_transform (image, &frame, transform, table, in,
+      allocator);
+}
+
+/**
+ * @brief Turn a packed RGB frame into the normalized CHW float tensor the model expects.
+ * @param pixels first pixel of the frame
+ * @param stride bytes per row of the frame
+ * @param in the tensor to fill, allocated from allocator
+ *
+ * This is the preprocessing of the sscma_yolov5 element. Tools that feed the
+ * same models (e.g. int8 calibration) must go through it so that they see
+ * exactly what the element feeds the network.
+ */
+void
+gst_sscma_preprocess (const guint8 * pixels, int width, int height,
+    int stride, int target_width, int target_height, ncnn::Mat & in,
+    ncnn::Allocator * allocator)
+{
+  GstSscmaImage image = { GST_SSCMA_PIXEL_RGB, width, height,
+    { (guint8 *) pixels, NULL, NULL }, { stride, 0, 0 }, FALSE };
+  GstSscmaInputTransform transform;
+
+  gst_sscma_input_transform_stretch (width, height, target_width,
+      target_height, &transform);
+  gst_sscma_preprocess_transform (&image, &transform, NULL, in, allocator);
+}
+
+/**
+ * @brief Number of tiles of a given length needed to cover length with the given overlap.
+ */
+static int
+gst_sscma_tile_count (int length, int tile, float overlap)
+{
+  const int step = MAX (1, (int) (tile * (1.f - overlap)));
+
+  if (tile >= length)
+    return 1;
+  return 1 + (length - tile + step - 1) / step;
+}
+
+/**
+ * @brief Cut a frame into overlapping tiles of tile_size x tile_size pixels.
+ *
+ * Tiles are spread evenly so that the first and the last ones touch the frame
+ * edges, their overlap is at least the given fraction of a tile. If that
+ * takes more than max_tiles tiles, the tiles grow until they fit.
+ *
+ * @param tiles filled with up to max_tiles tiles
+ * @return the number of tiles
+ */
+guint
+gst_sscma_tile_layout (int width, int height, int tile_size, float overlap,
+    guint max_tiles, GstSscmaTile * tiles)
+{
+  int size = MAX (tile_size, 1);
+  int tile_width, tile_height, nx, ny, i, j;
+  guint n = 0;
+
+  max_tiles = CLAMP (max_tiles, 1U, GST_SSCMA_MAX_TILES);
+  while (TRUE) {
+    tile_width = MIN (size, width);
+    tile_height = MIN (size, height);
+    nx = gst_sscma_tile_count (width, tile_width, overlap);
+    ny = gst_sscma_tile_count (height, tile_height, overlap);
+    if ((guint) (nx * ny) <= max_tiles)
+      break;
+    size += size / 4 + 1;
+  }
+
+  for (j = 0; j < ny; j++) {
+    for (i = 0; i < nx; i++) {
+      tiles[n].x = nx > 1 ? i * (width - tile_width) / (nx - 1) : 0;
+      tiles[n].y = ny > 1 ? j * (height - tile_height) / (ny - 1) : 0;
+      tiles[n].width = tile_width;
+      tiles[n].height = tile_height;
+      n++;
+    }
+  }
+
+  return n;
+}
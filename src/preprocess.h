@@ -0,0 +1,111 @@
+#ifndef __GST_SSCMA_PREPROCESS_H__
+#define __GST_SSCMA_PREPROCESS_H__
+
+#include <glib.h>
+#include <mat.h>
+
+/** @brief Letterboxed inputs are padded to a multiple of the largest model stride */
+#define GST_SSCMA_LETTERBOX_ALIGN 32
+/** @brief Normalized value of the letterbox padding, the gray yolov5 trains with */
+#define GST_SSCMA_LETTERBOX_PAD_VALUE (114 / 255.f)
+/** @brief Max number of tiles a frame is cut into */
+#define GST_SSCMA_MAX_TILES 64
+
+/**
+ * @brief How a source frame maps onto the model input.
+ *
+ * The frame is resized to resized_width x resized_height and placed at
+ * (pad_left, pad_top) in a width x height input, the rest is padding.
+ */
+typedef struct
+{
+  int width; /**< model input width */
+  int height; /**< model input height */
+  int resized_width; /**< width of the resized frame inside the input */
+  int resized_height; /**< height of the resized frame inside the input */
+  int pad_left; /**< padding columns left of the frame */
+  int pad_top; /**< padding rows above the frame */
+  float scale_x; /**< input pixels per source pixel, horizontally */
+  float scale_y; /**< input pixels per source pixel, vertically */
+} GstSscmaInputTransform;
+
+/**
+ * @brief Pixel layouts of the frames the element reads and draws on.
+ */
+typedef enum
+{
+  GST_SSCMA_PIXEL_RGB = 0, /**< packed 24-bit RGB */
+  GST_SSCMA_PIXEL_BGR, /**< packed 24-bit BGR */
+  GST_SSCMA_PIXEL_RGBA, /**< packed 32-bit RGBA or RGBx */
+  GST_SSCMA_PIXEL_BGRA, /**< packed 32-bit BGRA or BGRx */
+  GST_SSCMA_PIXEL_NV12, /**< Y plane, then interleaved UV at half resolution */
+  GST_SSCMA_PIXEL_I420, /**< Y, U and V planes, chroma at half resolution */
+  GST_SSCMA_PIXEL_YUY2, /**< packed Y0 U Y1 V, chroma at half horizontal resolution */
+} GstSscmaPixelFormat;
+
+/**
+ * @brief A mapped frame, any of the GstSscmaPixelFormat layouts.
+ */
+typedef struct
+{
+  GstSscmaPixelFormat format;
+  int width;
+  int height;
+  guint8 *planes[3]; /**< first byte of each plane, unused planes are NULL */
+  int strides[3]; /**< bytes per row of each plane */
+  gboolean bt709; /**< YUV formats: BT.709 instead of BT.601 coefficients */
+  gboolean full_range; /**< YUV formats: 0-255 instead of 16-235 luma, 16-240 chroma */
+} GstSscmaImage;
+
+/** @brief A region of the source frame inferred on its own */
+typedef struct
+{
+  int x;
+  int y;
+  int width;
+  int height;
+} GstSscmaTile;
+
+/**
+ * @brief Bilinear sampling positions of a resize, kept across frames of the same geometry.
+ *
+ * Zero initialize, gst_sscma_resize_table_clear() frees it.
+ */
+typedef struct
+{
+  GstSscmaTile roi; /**< source region the table samples */
+  int width; /**< resized width */
+  int height; /**< resized height */
+  int *x0; /**< per output column, left source column */
+  int *x1; /**< per output column, right source column */
+  float *wx; /**< per output column, weight of x1 */
+  int *y0; /**< per output row, top source row */
+  int *y1; /**< per output row, bottom source row */
+  float *wy; /**< per output row, weight of y1 */
+  float *rows; /**< 6 * width floats, the resized source rows packed formats blend */
+} GstSscmaResizeTable;
+
+int gst_sscma_pixel_stride (GstSscmaPixelFormat format);
+int gst_sscma_pixel_red_offset (GstSscmaPixelFormat format);
+
+void gst_sscma_preprocess (const guint8 * pixels, int width, int height,
+    int stride, int target_width, int target_height, ncnn::Mat & in,
+    ncnn::Allocator * allocator);
+
+void gst_sscma_input_transform_stretch (int width, int height,
+    int target_width, int target_height, GstSscmaInputTransform * transform);
+void gst_sscma_input_transform_letterbox (int width, int height,
+    int max_side, int align, GstSscmaInputTransform * transform);
+void gst_sscma_resize_table_clear (GstSscmaResizeTable * table);
+void gst_sscma_preprocess_transform (const GstSscmaImage * image,
+    const GstSscmaInputTransform * transform, GstSscmaResizeTable * table,
+    ncnn::Mat & in, ncnn::Allocator * allocator);
+
+void gst_sscma_preprocess_roi_transform (const GstSscmaImage * image,
+    const GstSscmaTile * roi, const GstSscmaInputTransform * transform,
+    GstSscmaResizeTable * table, ncnn::Mat & in, ncnn::Allocator * allocator);
+
+guint gst_sscma_tile_layout (int width, int height, int tile_size,
+    float overlap, guint max_tiles, GstSscmaTile * tiles);
+
+#endif /* __GST_SSCMA_PREPROCESS_H__ */
@@ -530,6 +530,59 @@ gst_tensor_parse_dimension (const gchar * dimstr, tensor_dim dim)
   return rank;
 }
 
+/**
+ * @brief String representations of each tensor element type.
+ */
+static const gchar *tensor_element_typename[] = {
+  [_TENOR_INT32] = "int32",
+  [_TENOR_UINT32] = "uint32",
+  [_TENOR_INT16] = "int16",
+  [_TENOR_UINT16] = "uint16",
+  [_TENOR_INT8] = "int8",
+  [_TENOR_UINT8] = "uint8",
+  [_TENOR_FLOAT64] = "float64",
+  [_TENOR_FLOAT32] = "float32",
+  [_TENOR_INT64] = "int64",
+  [_TENOR_UINT64] = "uint64",
+  [_TENOR_FLOAT16] = "float16",
+  [_TENOR_END] = NULL,
+};
+
+/**
+ * @brief Get type string of tensor type.
+ * @return The string, NULL if the type is invalid.
+ */
+const gchar *
+gst_tensor_get_type_string (tensor_type type)
+{
+  g_return_val_if_fail (type <= _TENOR_END, NULL);
+
+  return tensor_element_typename[type];
+}
+
+/**
+ * @brief Get dimension string from given tensor dimension.
+ * @param dim tensor dimension
+ * @return Formatted string of given dimension (d1:d2:d3:...), caller should free it.
+ */
+gchar *
+gst_tensor_get_dimension_string (const tensor_dim dim)
+{
+  guint i, rank;
+  GString *dim_str;
+
+  rank = gst_tensor_dimension_get_rank (dim);
+  dim_str = g_string_new (NULL);
+
+  for (i = 0; i < rank; i++) {
+    if (i > 0)
+      g_string_append (dim_str, ":");
+    g_string_append_printf (dim_str, "%u", dim[i]);
+  }
+
+  return g_string_free (dim_str, FALSE);
+}
+
 uint8_t rasters[][13] = {
 {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
 {0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18},
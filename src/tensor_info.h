@@ -161,6 +161,8 @@ guint gst_tensors_info_parse_types_string (GstTensorsInfo * info, const gchar *
 guint gst_tensor_dimension_get_rank (const tensor_dim dim);
 gboolean gst_tensor_dimension_is_valid (const tensor_dim dim);
 guint gst_tensor_parse_dimension (const gchar * dimstr, tensor_dim dim);
+gchar * gst_tensor_get_dimension_string (const tensor_dim dim);
+const gchar * gst_tensor_get_type_string (tensor_type type);
 void gst_tensors_layout_init (tensors_layout layout);
 void gst_tensors_rank_init (unsigned int ranks[]);
 
@@ -0,0 +1,316 @@
+/**
+ * sscma-calibrate: build an ncnn int8 calibration table for a float model.
+ *
+ * Sample frames go through the element's own preprocessing, then every
+ * Convolution, ConvolutionDepthWise and InnerProduct layer gets per-channel
+ * weight scales (max abs) and a bottom blob scale picked by minimizing the KL
+ * divergence between the float and the int8 activation distributions. The
+ * table is written in the ncnn2table format, ready for ncnn2int8.
+ *
+ * sscma-calibrate --param model.param --bin model.bin --images frames/ \
+ *     --size 320x320 --output model.table
+ */
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <vector>
+#include <gst/gst.h>
+#include <net.h>
+#include "layer/convolution.h"
+#include "layer/convolutiondepthwise.h"
+#include "layer/innerproduct.h"
+#include "preprocess.h"
+#include "frame_source.h"
+
+#define NUM_HISTOGRAM_BINS 2048
+#define NUM_QUANTIZE_BINS 128
+
+typedef struct
+{
+  ncnn::Net net;
+  int target_width;
+  int target_height;
+  std::vector<int> layers; /**< indices of the layers to quantize */
+  std::vector<float> absmax; /**< per layer, max abs value of the bottom blob */
+  std::vector<std::vector<float> > histograms; /**< per layer, |x| histogram of the bottom blob */
+  gboolean collect_histograms; /**< FALSE in the absmax pass, TRUE in the histogram pass */
+} Calibration;
+
+/**
+ * @brief Run one frame through the network and update the blob statistics.
+ */
+static gboolean
+calibrate_frame (const guint8 * rgb, gint width, gint height, gint stride,
+    gpointer user_data)
+{
+  Calibration *cal = (Calibration *) user_data;
+  ncnn::Extractor ex = cal->net.create_extractor ();
+  ncnn::Mat in;
+  size_t i;
+
+  gst_sscma_preprocess (rgb, width, height, stride, cal->target_width,
+      cal->target_height, in, NULL);
+  ex.input ("in0", in);
+
+  for (i = 0; i < cal->layers.size (); i++) {
+    const ncnn::Layer *layer = cal->net.layers ()[cal->layers[i]];
+    ncnn::Mat blob;
+
+    ex.extract (layer->bottoms[0], blob);
+    for (int q = 0; q < blob.c; q++) {
+      const float *ptr = blob.channel (q);
+      const int size = blob.w * blob.h * blob.d;
+
+      if (!cal->collect_histograms) {
+        for (int k = 0; k < size; k++)
+          cal->absmax[i] = MAX (cal->absmax[i], fabsf (ptr[k]));
+      } else if (cal->absmax[i] > 0.f) {
+        const float bin_width = cal->absmax[i] / NUM_HISTOGRAM_BINS;
+        for (int k = 0; k < size; k++) {
+          if (ptr[k] == 0.f)
+            continue;
+          int bin = (int) (fabsf (ptr[k]) / bin_width);
+          cal->histograms[i][MIN (bin, NUM_HISTOGRAM_BINS - 1)] += 1.f;
+        }
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+ * @brief KL divergence of two histograms, normalized internally.
+ */
+static float
+kl_divergence (const std::vector<float> & p, const std::vector<float> & q)
+{
+  float p_sum = 0.f, q_sum = 0.f, kl = 0.f;
+  size_t i;
+
+  for (i = 0; i < p.size (); i++) {
+    p_sum += p[i];
+    q_sum += q[i];
+  }
+  if (p_sum == 0.f || q_sum == 0.f)
+    return FLT_MAX;
+
+  for (i = 0; i < p.size (); i++) {
+    float pi = p[i] / p_sum;
+    float qi = q[i] / q_sum;
+    if (pi == 0.f)
+      continue;
+    kl += pi * logf (pi / MAX (qi, 1e-12f));
+  }
+  return kl;
+}
+
+/**
+ * @brief Pick the clipping bin whose 128-level quantization loses the least information.
+ * @return number of histogram bins kept below the threshold
+ */
+static int
+kl_threshold_bin (const std::vector<float> & histogram)
+{
+  const int length = (int) histogram.size ();
+  float min_kl = FLT_MAX;
+  int best = length;
+  float outliers = 0.f;
+  int threshold;
+
+  for (threshold = NUM_QUANTIZE_BINS; threshold < length; threshold++)
+    outliers += histogram[threshold];
+
+  for (threshold = NUM_QUANTIZE_BINS; threshold < length; threshold++) {
+    /* reference: clip the tail into the last kept bin */
+    std::vector<float> p (histogram.begin (), histogram.begin () + threshold);
+    std::vector<float> q (threshold, 0.f);
+    const int merge = threshold / NUM_QUANTIZE_BINS;
+    float kl;
+
+    p[threshold - 1] += outliers;
+    outliers -= histogram[threshold];
+
+    /* candidate: merge into 128 levels, then spread back over the non-empty bins */
+    for (int level = 0; level < NUM_QUANTIZE_BINS; level++) {
+      const int start = level * merge;
+      const int end = (level == NUM_QUANTIZE_BINS - 1) ? threshold : start + merge;
+      float sum = 0.f;
+      int nonzero = 0;
+
+      for (int j = start; j < end; j++) {
+        sum += p[j];
+        nonzero += (p[j] != 0.f);
+      }
+      if (nonzero == 0)
+        continue;
+      for (int j = start; j < end; j++) {
+        if (p[j] != 0.f)
+          q[j] = sum / nonzero;
+      }
+    }
+
+    kl = kl_divergence (p, q);
+    if (kl < min_kl) {
+      min_kl = kl;
+      best = threshold;
+    }
+  }
+
+  return best;
+}
+
+/**
+ * @brief Per output channel scales of the weights of a quantizable layer.
+ */
+static std::vector<float>
+weight_scales (const ncnn::Layer * layer)
+{
+  const ncnn::Mat *weights;
+  int channels;
+  std::vector<float> scales;
+
+  if (layer->type == "Convolution") {
+    const ncnn::Convolution *conv = (const ncnn::Convolution *) layer;
+    weights = &conv->weight_data;
+    channels = conv->num_output;
+  } else if (layer->type == "ConvolutionDepthWise") {
+    const ncnn::ConvolutionDepthWise *conv =
+        (const ncnn::ConvolutionDepthWise *) layer;
+    weights = &conv->weight_data;
+    channels = conv->group;
+  } else {
+    const ncnn::InnerProduct *fc = (const ncnn::InnerProduct *) layer;
+    weights = &fc->weight_data;
+    channels = fc->num_output;
+  }
+
+  const int per_channel = (int) (weights->total () / channels);
+  const float *ptr = (const float *) weights->data;
+  for (int c = 0; c < channels; c++) {
+    float absmax = 0.f;
+    for (int k = 0; k < per_channel; k++)
+      absmax = MAX (absmax, fabsf (ptr[c * per_channel + k]));
+    scales.push_back (absmax == 0.f ? 0.f : 127.f / absmax);
+  }
+
+  return scales;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gchar *param = NULL, *bin = NULL, *images = NULL, *output = NULL;
+  gchar *size = NULL;
+  gint max_frames = 200;
+  GOptionEntry entries[] = {
+    {"param", 0, 0, G_OPTION_ARG_FILENAME, &param, "Float model param file", "FILE"},
+    {"bin", 0, 0, G_OPTION_ARG_FILENAME, &bin, "Float model bin file", "FILE"},
+    {"images", 0, 0, G_OPTION_ARG_FILENAME, &images,
+        "Directory of sample images or videos", "DIR"},
+    {"size", 0, 0, G_OPTION_ARG_STRING, &size,
+        "Model input size, as the element's input property (default 320x320)", "WxH"},
+    {"frames", 0, 0, G_OPTION_ARG_INT, &max_frames,
+        "Max number of sample frames (default 200)", "N"},
+    {"output", 0, 0, G_OPTION_ARG_FILENAME, &output, "Calibration table to write", "FILE"},
+    {NULL}
+  };
+  GOptionContext *octx;
+  GError *err = NULL;
+  Calibration *cal;
+  guint frames;
+  size_t i;
+  FILE *fp;
+
+  octx = g_option_context_new ("- build an int8 calibration table for sscma_yolov5");
+  g_option_context_add_main_entries (octx, entries, NULL);
+  g_option_context_add_group (octx, gst_init_get_option_group ());
+  if (!g_option_context_parse (octx, &argc, &argv, &err)) {
+    g_printerr ("%s\n", err->message);
+    return 1;
+  }
+  g_option_context_free (octx);
+
+  if (!param || !bin || !images || !output) {
+    g_printerr ("--param, --bin, --images and --output are required\n");
+    return 1;
+  }
+
+  cal = new Calibration ();
+  cal->target_width = cal->target_height = 320;
+  if (size && sscanf (size, "%dx%d", &cal->target_width, &cal->target_height) != 2) {
+    g_printerr ("Invalid size %s\n", size);
+    return 1;
+  }
+
+  /* keep float blobs and the original weights around */
+  cal->net.opt.lightmode = false;
+  cal->net.opt.use_fp16_packed = false;
+  cal->net.opt.use_fp16_storage = false;
+  cal->net.opt.use_fp16_arithmetic = false;
+  cal->net.opt.use_packing_layout = false;
+  if (cal->net.load_param (param) != 0 || cal->net.load_model (bin) != 0) {
+    g_printerr ("Cannot load %s / %s\n", param, bin);
+    return 1;
+  }
+
+  for (i = 0; i < cal->net.layers ().size (); i++) {
+    const ncnn::Layer *layer = cal->net.layers ()[i];
+    if (layer->type == "Convolution" || layer->type == "ConvolutionDepthWise"
+        || layer->type == "InnerProduct")
+      cal->layers.push_back ((int) i);
+  }
+  cal->absmax.assign (cal->layers.size (), 0.f);
+  cal->histograms.assign (cal->layers.size (),
+      std::vector<float> (NUM_HISTOGRAM_BINS, 0.f));
+
+  cal->collect_histograms = FALSE;
+  frames = sscma_foreach_frame (images, max_frames, calibrate_frame, cal);
+  if (frames == 0) {
+    g_printerr ("No sample frame found in %s\n", images);
+    return 1;
+  }
+  g_print ("Pass 1/2: blob ranges over %u frames\n", frames);
+
+  cal->collect_histograms = TRUE;
+  sscma_foreach_frame (images, max_frames, calibrate_frame, cal);
+  g_print ("Pass 2/2: blob histograms over %u frames\n", frames);
+
+  fp = fopen (output, "wb");
+  if (fp == NULL) {
+    g_printerr ("Cannot write %s\n", output);
+    return 1;
+  }
+
+  for (i = 0; i < cal->layers.size (); i++) {
+    const ncnn::Layer *layer = cal->net.layers ()[cal->layers[i]];
+    std::vector<float> scales = weight_scales (layer);
+
+    fprintf (fp, "%s_param_0", layer->name.c_str ());
+    for (size_t c = 0; c < scales.size (); c++)
+      fprintf (fp, " %f", scales[c]);
+    fprintf (fp, "\n");
+  }
+
+  for (i = 0; i < cal->layers.size (); i++) {
+    const ncnn::Layer *layer = cal->net.layers ()[cal->layers[i]];
+    const float bin_width = cal->absmax[i] / NUM_HISTOGRAM_BINS;
+    float threshold, scale = 0.f;
+
+    if (cal->absmax[i] > 0.f) {
+      threshold = (kl_threshold_bin (cal->histograms[i]) + 0.5f) * bin_width;
+      scale = 127.f / threshold;
+    }
+    fprintf (fp, "%s %f\n", layer->name.c_str (), scale);
+    g_print ("%-32s absmax %10.4f  scale %10.4f\n", layer->name.c_str (),
+        cal->absmax[i], scale);
+  }
+  fclose (fp);
+
+  g_print ("Wrote %s, %zu layers. Quantize with:\n"
+      "  ncnn2int8 %s %s int8.param int8.bin %s\n", output, cal->layers.size (),
+      param, bin, output);
+
+  delete cal;
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include <string.h>
+#include <gst/app/gstappsink.h>
+#include <gst/video/video.h>
+#include "frame_source.h"
+
+/**
+ * @brief Decode one image or video file to RGB and hand its frames to func.
+ * @param[out] stop set to TRUE if func asked to stop
+ * @return number of frames handed out
+ */
+static guint
+sscma_foreach_frame_in_file (const gchar * path, guint max_frames,
+    SscmaFrameFunc func, gpointer user_data, gboolean * stop)
+{
+  GstElement *pipeline, *src, *sink;
+  GError *err = NULL;
+  GstSample *sample;
+  guint frames = 0;
+
+  pipeline = gst_parse_launch ("filesrc name=src ! decodebin ! videoconvert ! "
+      "video/x-raw,format=RGB ! appsink name=sink sync=false", &err);
+  if (pipeline == NULL) {
+    g_printerr ("Cannot build decoding pipeline: %s\n", err->message);
+    g_clear_error (&err);
+    return 0;
+  }
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_object_set (src, "location", path, NULL);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  while (frames < max_frames
+      && (sample = gst_app_sink_pull_sample (GST_APP_SINK (sink)))) {
+    GstVideoInfo vinfo;
+    GstVideoFrame frame;
+    gboolean more = TRUE;
+
+    if (gst_video_info_from_caps (&vinfo, gst_sample_get_caps (sample))
+        && gst_video_frame_map (&frame, &vinfo, gst_sample_get_buffer (sample),
+            GST_MAP_READ)) {
+      more = func ((const guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&frame, 0),
+          GST_VIDEO_FRAME_WIDTH (&frame), GST_VIDEO_FRAME_HEIGHT (&frame),
+          GST_VIDEO_FRAME_PLANE_STRIDE (&frame, 0), user_data);
+      gst_video_frame_unmap (&frame);
+      frames++;
+    }
+    gst_sample_unref (sample);
+
+    if (!more) {
+      *stop = TRUE;
+      break;
+    }
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (src);
+  gst_object_unref (sink);
+  gst_object_unref (pipeline);
+
+  if (frames == 0)
+    g_printerr ("No frame decoded from %s\n", path);
+  return frames;
+}
+
+/**
+ * @brief Compare function for g_ptr_array_sort with file paths.
+ */
+static gint
+compare_path (gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0 (*(const gchar **) a, *(const gchar **) b);
+}
+
+/**
+ * @brief Decode every image or video in a directory, in name order.
+ * @param max_frames stop after that many frames in total
+ * @return number of frames handed to func
+ */
+guint
+sscma_foreach_frame (const gchar * dir, guint max_frames, SscmaFrameFunc func,
+    gpointer user_data)
+{
+  GDir *gdir;
+  GError *err = NULL;
+  GPtrArray *files;
+  const gchar *name;
+  guint i, total = 0;
+  gboolean stop = FALSE;
+
+  gdir = g_dir_open (dir, 0, &err);
+  if (gdir == NULL) {
+    g_printerr ("Cannot open %s: %s\n", dir, err->message);
+    g_clear_error (&err);
+    return 0;
+  }
+
+  files = g_ptr_array_new_with_free_func (g_free);
+  while ((name = g_dir_read_name (gdir))) {
+    gchar *path = g_build_filename (dir, name, NULL);
+    if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+      g_ptr_array_add (files, path);
+    else
+      g_free (path);
+  }
+  g_dir_close (gdir);
+  g_ptr_array_sort (files, compare_path);
+
+  for (i = 0; i < files->len && total < max_frames && !stop; i++) {
+    total += sscma_foreach_frame_in_file (
+        (const gchar *) g_ptr_array_index (files, i), max_frames - total,
+        func, user_data, &stop);
+  }
+
+  g_ptr_array_unref (files);
+  return total;
+}
@@ -0,0 +1,16 @@
+#ifndef __SSCMA_TOOLS_FRAME_SOURCE_H__
+#define __SSCMA_TOOLS_FRAME_SOURCE_H__
+
+#include <gst/gst.h>
+
+/**
+ * @brief Called for every decoded frame, packed RGB with the given row stride.
+ * @return FALSE to stop the iteration
+ */
+typedef gboolean (*SscmaFrameFunc) (const guint8 * rgb, gint width,
+    gint height, gint stride, gpointer user_data);
+
+guint sscma_foreach_frame (const gchar * dir, guint max_frames,
+    SscmaFrameFunc func, gpointer user_data);
+
+#endif /* __SSCMA_TOOLS_FRAME_SOURCE_H__ */
@@ -0,0 +1,209 @@
+/**
+ * sscma-int8-report: compare an int8 quantized model against its float original.
+ *
+ * Both networks get the same frames through the element's own preprocessing.
+ * The report gives the mean inference latency of each model, the cosine
+ * similarity of their raw outputs, and how well the int8 detections (anchors
+ * whose obj * class score passes the threshold) agree with the float ones.
+ *
+ * sscma-int8-report --float-param f.param --float-bin f.bin \
+ *     --int8-param i.param --int8-bin i.bin --images frames/ --size 320x320
+ */
+#include <math.h>
+#include <stdio.h>
+#include <gst/gst.h>
+#include <net.h>
+#include "preprocess.h"
+#include "frame_source.h"
+
+#define DETECTION_NUM_INFO 5
+
+typedef struct
+{
+  ncnn::Net float_net;
+  ncnn::Net int8_net;
+  int target_width;
+  int target_height;
+  int num_threads;
+  double threshold;
+
+  guint frames;
+  gdouble float_ms; /**< total float inference time */
+  gdouble int8_ms; /**< total int8 inference time */
+  gdouble cosine; /**< sum of the per frame output cosine similarity */
+  guint64 matched; /**< anchors detected by both, with the same class */
+  guint64 float_only; /**< anchors only the float model detects */
+  guint64 int8_only; /**< anchors only the int8 model detects, or with another class */
+} Report;
+
+/**
+ * @brief Run a network and return its output and latency in ms.
+ */
+static gdouble
+run_net (ncnn::Net & net, const ncnn::Mat & in, int num_threads, ncnn::Mat & out)
+{
+  ncnn::Extractor ex = net.create_extractor ();
+  gint64 start = g_get_monotonic_time ();
+
+  ex.set_num_threads (num_threads);
+  ex.input ("in0", in);
+  ex.extract ("out0", out);
+
+  return (g_get_monotonic_time () - start) / 1000.0;
+}
+
+/**
+ * @brief Best class of an anchor row, -1 if its score does not pass the threshold.
+ */
+static int
+detect (const float *row, int channels, double threshold)
+{
+  float max_val = 0.f;
+  int max_index = -1;
+
+  for (int i = DETECTION_NUM_INFO; i < channels; i++) {
+    if (row[i] > max_val) {
+      max_val = row[i];
+      max_index = i - DETECTION_NUM_INFO;
+    }
+  }
+
+  return (max_val * row[4] > threshold) ? max_index : -1;
+}
+
+static gboolean
+report_frame (const guint8 * rgb, gint width, gint height, gint stride,
+    gpointer user_data)
+{
+  Report *report = (Report *) user_data;
+  ncnn::Mat in, float_out, int8_out;
+  double dot = 0, float_norm = 0, int8_norm = 0;
+
+  gst_sscma_preprocess (rgb, width, height, stride, report->target_width,
+      report->target_height, in, NULL);
+
+  report->float_ms += run_net (report->float_net, in, report->num_threads,
+      float_out);
+  report->int8_ms += run_net (report->int8_net, in, report->num_threads,
+      int8_out);
+
+  if (float_out.w != int8_out.w || float_out.h != int8_out.h) {
+    g_printerr ("Output shapes differ: %dx%d vs %dx%d\n", float_out.w,
+        float_out.h, int8_out.w, int8_out.h);
+    return FALSE;
+  }
+
+  for (int y = 0; y < float_out.h; y++) {
+    const float *f = float_out.row (y);
+    const float *q = int8_out.row (y);
+    int f_class, q_class;
+
+    for (int x = 0; x < float_out.w; x++) {
+      dot += f[x] * q[x];
+      float_norm += f[x] * f[x];
+      int8_norm += q[x] * q[x];
+    }
+
+    f_class = detect (f, float_out.w, report->threshold);
+    q_class = detect (q, int8_out.w, report->threshold);
+    if (f_class >= 0 && q_class == f_class)
+      report->matched++;
+    else {
+      if (f_class >= 0)
+        report->float_only++;
+      if (q_class >= 0)
+        report->int8_only++;
+    }
+  }
+
+  if (float_norm > 0 && int8_norm > 0)
+    report->cosine += dot / (sqrt (float_norm) * sqrt (int8_norm));
+  report->frames++;
+
+  return TRUE;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gchar *float_param = NULL, *float_bin = NULL;
+  gchar *int8_param = NULL, *int8_bin = NULL;
+  gchar *images = NULL, *size = NULL;
+  gint max_frames = 100;
+  Report *report = new Report ();
+  GOptionEntry entries[] = {
+    {"float-param", 0, 0, G_OPTION_ARG_FILENAME, &float_param, "Float model param file", "FILE"},
+    {"float-bin", 0, 0, G_OPTION_ARG_FILENAME, &float_bin, "Float model bin file", "FILE"},
+    {"int8-param", 0, 0, G_OPTION_ARG_FILENAME, &int8_param, "Int8 model param file", "FILE"},
+    {"int8-bin", 0, 0, G_OPTION_ARG_FILENAME, &int8_bin, "Int8 model bin file", "FILE"},
+    {"images", 0, 0, G_OPTION_ARG_FILENAME, &images,
+        "Directory of sample images or videos", "DIR"},
+    {"size", 0, 0, G_OPTION_ARG_STRING, &size,
+        "Model input size (default 320x320)", "WxH"},
+    {"frames", 0, 0, G_OPTION_ARG_INT, &max_frames,
+        "Max number of frames (default 100)", "N"},
+    {"threshold", 0, 0, G_OPTION_ARG_DOUBLE, &report->threshold,
+        "Detection threshold, as the element's threshold property (default 2500)", "T"},
+    {"numthreads", 0, 0, G_OPTION_ARG_INT, &report->num_threads,
+        "Number of threads (default 4)", "N"},
+    {NULL}
+  };
+  GOptionContext *octx;
+  GError *err = NULL;
+  guint64 float_total, int8_total;
+
+  report->target_width = report->target_height = 320;
+  report->threshold = 2500;
+  report->num_threads = 4;
+
+  octx = g_option_context_new ("- compare an int8 model against its float original");
+  g_option_context_add_main_entries (octx, entries, NULL);
+  g_option_context_add_group (octx, gst_init_get_option_group ());
+  if (!g_option_context_parse (octx, &argc, &argv, &err)) {
+    g_printerr ("%s\n", err->message);
+    return 1;
+  }
+  g_option_context_free (octx);
+
+  if (!float_param || !float_bin || !int8_param || !int8_bin || !images) {
+    g_printerr ("--float-param, --float-bin, --int8-param, --int8-bin and "
+        "--images are required\n");
+    return 1;
+  }
+  if (size && sscanf (size, "%dx%d", &report->target_width,
+          &report->target_height) != 2) {
+    g_printerr ("Invalid size %s\n", size);
+    return 1;
+  }
+
+  if (report->float_net.load_param (float_param) != 0
+      || report->float_net.load_model (float_bin) != 0
+      || report->int8_net.load_param (int8_param) != 0
+      || report->int8_net.load_model (int8_bin) != 0) {
+    g_printerr ("Cannot load the models\n");
+    return 1;
+  }
+
+  sscma_foreach_frame (images, max_frames, report_frame, report);
+  if (report->frames == 0) {
+    g_printerr ("No frame compared\n");
+    return 1;
+  }
+
+  float_total = report->matched + report->float_only;
+  int8_total = report->matched + report->int8_only;
+  g_print ("frames                 %u\n", report->frames);
+  g_print ("float latency          %.2f ms\n", report->float_ms / report->frames);
+  g_print ("int8 latency           %.2f ms\n", report->int8_ms / report->frames);
+  g_print ("speedup                %.2fx\n", report->float_ms / report->int8_ms);
+  g_print ("output cosine          %.4f\n", report->cosine / report->frames);
+  g_print ("detections float/int8  %" G_GUINT64_FORMAT " / %" G_GUINT64_FORMAT "\n",
+      float_total, int8_total);
+  g_print ("int8 recall            %.4f\n",
+      float_total ? (double) report->matched / float_total : 1.0);
+  g_print ("int8 precision         %.4f\n",
+      int8_total ? (double) report->matched / int8_total : 1.0);
+
+  delete report;
+  return 0;
+}
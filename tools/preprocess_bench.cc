@@ -0,0 +1,103 @@
+/**
+ * sscma-preprocess-bench: time the element's preprocessing against the ncnn one.
+ *
+ * A random RGB frame is resized to the model input, normalized and laid out
+ * as CHW floats, once with ncnn::Mat::from_pixels_resize and
+ * substract_mean_normalize (two passes over the tensor), once with
+ * gst_sscma_preprocess_transform (one pass). The report gives the mean time
+ * of each, the speedup and the largest difference between their outputs.
+ *
+ * sscma-preprocess-bench --size 1920x1080 --input 640x640 --iterations 500
+ */
+#include <math.h>
+#include <stdio.h>
+#include <glib.h>
+#include <mat.h>
+#include "preprocess.h"
+
+int
+main (int argc, char *argv[])
+{
+  gchar *size = NULL, *input = NULL;
+  gint iterations = 200;
+  GOptionEntry entries[] = {
+    {"size", 0, 0, G_OPTION_ARG_STRING, &size,
+        "Frame size (default 1280x720)", "WxH"},
+    {"input", 0, 0, G_OPTION_ARG_STRING, &input,
+        "Model input size (default 320x320)", "WxH"},
+    {"iterations", 0, 0, G_OPTION_ARG_INT, &iterations,
+        "Runs of each preprocessing (default 200)", "N"},
+    {NULL}
+  };
+  const float norm_vals[3] = { 1 / 255.f, 1 / 255.f, 1 / 255.f };
+  int width = 1280, height = 720, target_width = 320, target_height = 320;
+  GOptionContext *octx;
+  GError *err = NULL;
+  GstSscmaImage image = { GST_SSCMA_PIXEL_RGB };
+  GstSscmaInputTransform transform;
+  GstSscmaResizeTable table = { 0 };
+  ncnn::Mat reference, fused;
+  GRand *rand;
+  gint64 start;
+  gdouble ncnn_ms, fused_ms;
+  float max_diff = 0.f;
+
+  octx = g_option_context_new ("- time the sscma_yolov5 preprocessing");
+  g_option_context_add_main_entries (octx, entries, NULL);
+  if (!g_option_context_parse (octx, &argc, &argv, &err)) {
+    g_printerr ("%s\n", err->message);
+    return 1;
+  }
+  g_option_context_free (octx);
+
+  if ((size && sscanf (size, "%dx%d", &width, &height) != 2)
+      || (input && sscanf (input, "%dx%d", &target_width,
+              &target_height) != 2) || width <= 0 || height <= 0
+      || target_width <= 0 || target_height <= 0 || iterations <= 0) {
+    g_printerr ("Invalid size, input or iterations\n");
+    return 1;
+  }
+
+  image.width = width;
+  image.height = height;
+  image.strides[0] = width * 3;
+  image.planes[0] = (guint8 *) g_malloc ((gsize) image.strides[0] * height);
+  rand = g_rand_new_with_seed (0);
+  for (int i = 0; i < image.strides[0] * height; i++)
+    image.planes[0][i] = (guint8) g_rand_int_range (rand, 0, 256);
+  g_rand_free (rand);
+  gst_sscma_input_transform_stretch (width, height, target_width,
+      target_height, &transform);
+
+  start = g_get_monotonic_time ();
+  for (int i = 0; i < iterations; i++) {
+    reference = ncnn::Mat::from_pixels_resize (image.planes[0],
+        ncnn::Mat::PIXEL_RGB, width, height, image.strides[0], target_width,
+        target_height);
+    reference.substract_mean_normalize (0, norm_vals);
+  }
+  ncnn_ms = (g_get_monotonic_time () - start) / 1000.0 / iterations;
+
+  start = g_get_monotonic_time ();
+  for (int i = 0; i < iterations; i++)
+    gst_sscma_preprocess_transform (&image, &transform, &table, fused, NULL);
+  fused_ms = (g_get_monotonic_time () - start) / 1000.0 / iterations;
+
+  for (int q = 0; q < 3; q++) {
+    const float *a = reference.channel (q);
+    const float *b = fused.channel (q);
+    for (int k = 0; k < target_width * target_height; k++)
+      max_diff = MAX (max_diff, fabsf (a[k] - b[k]));
+  }
+
+  g_print ("frame                  %dx%d RGB\n", width, height);
+  g_print ("input                  %dx%d\n", target_width, target_height);
+  g_print ("ncnn                   %.3f ms\n", ncnn_ms);
+  g_print ("fused                  %.3f ms\n", fused_ms);
+  g_print ("speedup                %.2fx\n", ncnn_ms / fused_ms);
+  g_print ("max abs difference     %.4f\n", max_diff);
+
+  gst_sscma_resize_table_clear (&table);
+  g_free (image.planes[0]);
+  return 0;
+}